@@ -0,0 +1,290 @@
+/// Copyright [2022] <Mauricio Konrath>
+
+/// benchmark do processamento de XML com imagens binárias:
+/// gera um conjunto sintético, roda as fases do main.cpp separadamente e
+/// mostra a vazão de cada uma e o pico de memória
+///
+/// compilar com: g++ -std=c++17 -O2 -pthread benchmark.cpp -o benchmark
+
+#define PROJETO_SEM_MAIN
+#include "main.cpp"
+
+#include <chrono> ///relógio
+#include <random> ///gerador pseudoaleatório
+#include <cstdlib> ///mkstemp
+
+#include <sys/resource.h> ///getrusage
+
+namespace benchmark {
+    /// formas das imagens sintéticas
+    enum class forma {
+        /// pixels brancos sorteados com a densidade dada
+        aleatoria,
+        /// um único caminho em espiral de um pixel de largura, o pior caso da pilha
+        espiral,
+        /// tabuleiro de xadrez: com 4 vizinhos, cada pixel branco é uma área
+        xadrez,
+    };
+
+    /// parâmetros do conjunto gerado
+    struct parametros {
+        int imagens{100};
+        int largura{512};
+        int altura{512};
+        double densidade{0.5};
+        forma tipo{forma::aleatoria};
+        int repeticoes{3};
+        unsigned semente{2022u};
+    };
+
+    /// lê os parâmetros; retorna false se algum for inválido
+    bool le_parametros(int argc, char* argv[], parametros& saida);
+    /// gera os pixels de uma imagem, como texto de '0's e '1's com uma linha por linha da imagem
+    void gera_dados(const parametros& p, std::mt19937_64& sorteio, std::string& saida);
+    /// gera o arquivo xml inteiro
+    std::string gera_xml(const parametros& p);
+    /// grava o texto num arquivo temporário e retorna o nome dele
+    std::string grava_temporario(const std::string& texto);
+    /// pico de memória residente do processo, em MB
+    double pico_rss();
+    /// segundos decorridos desde inicio
+    double segundos(std::chrono::steady_clock::time_point inicio);
+    /// mostra uma linha da tabela de resultados
+    void relata(const char* fase, double tempo, double quantidade, const char* unidade);
+}   /// namespace benchmark
+
+int main(int argc, char* argv[]) {
+    benchmark::parametros p;
+    if (not benchmark::le_parametros(argc, argv, p)) {
+        std::cerr << "uso: " << argv[0]
+                  << " [--imagens N] [--largura N] [--altura N] [--densidade D]"
+                  << " [--forma aleatoria|espiral|xadrez] [--repeticoes N] [--semente N]"
+                  << std::endl;
+        return -1;
+    }
+
+    const std::string nome = benchmark::grava_temporario(benchmark::gera_xml(p));
+    const double pixels = static_cast<double>(p.imagens) * p.largura * p.altura;
+    std::printf("%d imagens %dx%d, pico de memória após gerar: %.1f MB\n",
+                p.imagens, p.largura, p.altura, benchmark::pico_rss());
+
+    for (int r = 0; r < p.repeticoes; r++) {
+        std::printf("\nrepetição %d\n", r + 1);
+
+        /// leitura e varredura única do arquivo (validação + posição das imagens)
+        auto inicio = std::chrono::steady_clock::now();
+        xml::arquivo xmlfile;
+        std::vector<xml::registro> imagens;
+        if (not xmlfile.abre(nome) || not xml::varre(xmlfile.dados(), xmlfile.tamanho(), imagens)) {
+            std::cerr << "error" << std::endl;
+            std::remove(nome.c_str());
+            return -1;
+        }
+        const double megabytes = xmlfile.tamanho() / (1024.0 * 1024.0);
+        benchmark::relata("abre+varre", benchmark::segundos(inicio), megabytes, "MB");
+
+        /// extração dos campos de cada imagem: a varredura já achou os valores
+        inicio = std::chrono::steady_clock::now();
+        struct campos {
+            std::string_view data;
+            int largura;
+            int altura;
+        };
+        std::vector<campos> extraidos;
+        for (const xml::registro& reg : imagens) {
+            extraidos.push_back({
+                reg.data.em(xmlfile.dados()),
+                xml::para_int(reg.width.em(xmlfile.dados())),
+                xml::para_int(reg.height.em(xmlfile.dados()))});
+        }
+        benchmark::relata("campos", benchmark::segundos(inicio), megabytes, "MB");
+
+        /// decodificação do texto para bitmaps
+        inicio = std::chrono::steady_clock::now();
+        std::vector<area::bitmap> matrizes;
+        for (const campos& c : extraidos) {
+            matrizes.push_back(area::matriz_nova(c.data, c.largura, c.altura));
+        }
+        benchmark::relata("matriz_nova", benchmark::segundos(inicio), pixels, "pixels");
+
+        /// rotulação com cada algoritmo; as contagens precisam coincidir
+        struct variante {
+            const char* nome;
+            area::algoritmo modo;
+            int faixas;
+        };
+        const int nucleos = std::max(1u, std::thread::hardware_concurrency());
+        const variante variantes[] = {
+            {"area_contador preenchimento", area::algoritmo::preenchimento, 1},
+            {"area_contador varredura", area::algoritmo::varredura, 1},
+            {"area_contador uniao", area::algoritmo::uniao_busca, 1},
+            {"area_contador bits", area::algoritmo::bits, 1},
+            {"area_contador uniao+faixas", area::algoritmo::uniao_busca, nucleos},
+        };
+        long long referencia = -1;
+        for (const variante& v : variantes) {
+            inicio = std::chrono::steady_clock::now();
+            long long total = 0;
+            for (const area::bitmap& m : matrizes) {
+                total += area::area_contador(m, v.modo, v.faixas);
+            }
+            benchmark::relata(v.nome, benchmark::segundos(inicio), pixels, "pixels");
+            if (referencia >= 0 && total != referencia) {
+                std::printf("  divergência: %lld áreas, esperado %lld\n", total, referencia);
+            }
+            referencia = total;
+        }
+        std::printf("  %lld áreas no total\n", referencia);
+    }
+
+    std::printf("\npico de memória: %.1f MB\n", benchmark::pico_rss());
+    std::remove(nome.c_str());
+    return 0;
+}
+
+namespace benchmark {
+bool le_parametros(int argc, char* argv[], parametros& saida) {
+    for (int i = 1; i < argc; i++) {
+        const std::string_view opcao = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const std::string valor = argv[++i];
+        try {
+            if (opcao == "--imagens") {
+                saida.imagens = std::stoi(valor);
+            } else if (opcao == "--largura") {
+                saida.largura = std::stoi(valor);
+            } else if (opcao == "--altura") {
+                saida.altura = std::stoi(valor);
+            } else if (opcao == "--densidade") {
+                saida.densidade = std::stod(valor);
+            } else if (opcao == "--repeticoes") {
+                saida.repeticoes = std::stoi(valor);
+            } else if (opcao == "--semente") {
+                saida.semente = static_cast<unsigned>(std::stoul(valor));
+            } else if (opcao == "--forma") {
+                if (valor == "aleatoria") {
+                    saida.tipo = forma::aleatoria;
+                } else if (valor == "espiral") {
+                    saida.tipo = forma::espiral;
+                } else if (valor == "xadrez") {
+                    saida.tipo = forma::xadrez;
+                } else {
+                    return false;
+                }
+            } else {
+                return false;
+            }
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return saida.imagens > 0 && saida.largura > 0 && saida.altura > 0 && saida.repeticoes > 0;
+}
+
+void gera_dados(const parametros& p, std::mt19937_64& sorteio, std::string& saida) {
+    const int largura = p.largura;
+    const int altura = p.altura;
+    std::vector<char> pixels(static_cast<std::size_t>(largura) * altura, '0');
+
+    if (p.tipo == forma::aleatoria) {
+        std::bernoulli_distribution branco(p.densidade);
+        for (char& c : pixels) {
+            c = branco(sorteio) ? '1' : '0';
+        }
+    } else if (p.tipo == forma::xadrez) {
+        for (int i = 0; i < altura; i++) {
+            for (int j = 0; j < largura; j++) {
+                pixels[static_cast<std::size_t>(i) * largura + j] = (i + j) % 2 ? '0' : '1';
+            }
+        }
+    } else {
+        /// anda para frente enquanto a casa seguinte e a depois dela estão livres,
+        /// virando à direita quando não dá; o caminho deixa um pixel preto entre as voltas
+        auto livre = [&](int i, int j) {
+            return i >= 0 && i < altura && j >= 0 && j < largura
+                && pixels[static_cast<std::size_t>(i) * largura + j] == '0';
+        };
+        const int di[] = {0, 1, 0, -1};
+        const int dj[] = {1, 0, -1, 0};
+        int i = 0;
+        int j = 0;
+        int d = 0;
+        int viradas = 0;
+        pixels[0] = '1';
+        while (viradas < 2) {
+            const int ni = i + di[d];
+            const int nj = j + dj[d];
+            const int ni2 = ni + di[d];
+            const int nj2 = nj + dj[d];
+            const bool depois_livre = (ni2 < 0 || ni2 >= altura || nj2 < 0 || nj2 >= largura)
+                || livre(ni2, nj2);
+            if (livre(ni, nj) && depois_livre) {
+                i = ni;
+                j = nj;
+                pixels[static_cast<std::size_t>(i) * largura + j] = '1';
+                viradas = 0;
+            } else {
+                d = (d + 1) % 4;
+                viradas++;
+            }
+        }
+    }
+
+    saida.clear();
+    for (int i = 0; i < altura; i++) {
+        saida.append(pixels.data() + static_cast<std::size_t>(i) * largura, largura);
+        saida.append(1, '\n');
+    }
+}
+
+std::string gera_xml(const parametros& p) {
+    std::mt19937_64 sorteio(p.semente);
+    std::string xml = "<dataset>\n";
+    std::string dados;
+    for (int k = 0; k < p.imagens; k++) {
+        gera_dados(p, sorteio, dados);
+        xml.append("<img>\n<name>bench_").append(std::to_string(k)).append(".png</name>\n");
+        xml.append("<height>").append(std::to_string(p.altura)).append("</height>\n");
+        xml.append("<width>").append(std::to_string(p.largura)).append("</width>\n");
+        xml.append("<data>\n").append(dados).append("</data>\n</img>\n");
+    }
+    xml.append("</dataset>\n");
+    return xml;
+}
+
+std::string grava_temporario(const std::string& texto) {
+    char nome[] = "/tmp/benchmark_xml_XXXXXX";
+    int fd = mkstemp(nome);
+    if (fd < 0) {
+        throw std::runtime_error("não foi possível criar o arquivo temporário");
+    }
+    std::size_t escrito = 0u;
+    while (escrito < texto.length()) {
+        ssize_t n = ::write(fd, texto.data() + escrito, texto.length() - escrito);
+        if (n <= 0) {
+            ::close(fd);
+            throw std::runtime_error("não foi possível gravar o arquivo temporário");
+        }
+        escrito += n;
+    }
+    ::close(fd);
+    return nome;
+}
+
+double pico_rss() {
+    struct rusage uso;
+    getrusage(RUSAGE_SELF, &uso);
+    return uso.ru_maxrss / 1024.0;
+}
+
+double segundos(std::chrono::steady_clock::time_point inicio) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+}
+
+void relata(const char* fase, double tempo, double quantidade, const char* unidade) {
+    std::printf("  %-30s %9.3f ms %12.1f %s/s\n",
+                fase, tempo * 1e3, tempo > 0 ? quantidade / tempo : 0.0, unidade);
+}
+}   /// namespace benchmark
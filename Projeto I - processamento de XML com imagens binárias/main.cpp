@@ -1,347 +1,3688 @@
-/// Copyright [2022] <Mauricio Konrath>
-
-#ifndef STRUCTURES_LINKED_STACK_H
-#define STRUCTURES_LINKED_STACK_H
-
-
-#include <iostream> ///ler e gravar
-#include <fstream> ///arquivos
-#include <sstream> ///dados
-#include <tuple> ///tupla
-#include <stack> ///pilha
-#include <string> ///string e memória
-#include <vector> ///array
-#include <stdexcept> ///exceções em c++
-#include <algorithm> ///intervalos
-#include <utility> /// outras funções
-#include <cstdint> ///std::size_t
-
-
-namespace xml {
-///obtem a tag
-std::string get_tag(
-    const std::string& source, 
-    const std::string& open_tag,
-    const std::string& close_tag, 
-    size_t& start_index);
-///obtem o valor
-std::string get_value(
-    const std::string& source,
-    const std::string& open_tag,
-    const std::string& close_tag);
-bool valida(const std::string& contents); ///validar o xml
-
-} ///namespace xml
-
-namespace structures {
-///classe LinkedStack
-template<typename T>
-class LinkedStack {
- public:
-    LinkedStack(); ///construtor simples    
-    ~LinkedStack(); ///destrutor    
-    void clear(); ///limpa pilha
-    void push(const T& data); /// empilha    
-    T pop(); ///desempilha    
-    T& top() const; ///retorna ao topo    
-    bool empty() const; ///ve se está vazia   
-    std::size_t size() const; ///retorna o tamanho
- 
- private:
-    class Node {   
-     public:
-        explicit Node(const T &data) {
-            data_ = data;
-            next_ = nullptr;
-        }
-
-        Node(const T& data, Node* next) {
-            data_ = data;
-            next_ = next;
-        }
-
-        T& data() { /// getter: dado   
-            return data_;
-        }
-
-        const T& data() const { /// getter const: dado  
-            return data_;
-        }
-
-        Node* next() { /// getter: próximo
-            return next_;
-        }
-
-        const Node* next() const { /// getter const: próximo
-            return next_;
-        }
-
-        void next(Node* node) { /// setter: próximo  
-            next_ = node;
-        }
-
-     private:
-        T data_;
-        Node* next_{nullptr};
-    };
-
-    Node* top_{nullptr};
-    std::size_t size_{0u};
-};
-}   /// namespace structures
-
-namespace area {
-    /// vai enumerar as sequencias dos pixels
-    enum cor {
-        /// 0 para preto
-        preto,
-        /// 1 para branco
-        branco,
-    };
-    /// vai contar as areas em branco
-    int area_contador(std::vector<std::vector<bool>> matrix);
-    /// vai transformar uma area inteira da matriz em zeros
-    void area_transformada(std::vector<std::vector<bool>>& matrix, int i, int j);
-    /// vai criar uma nova matriz a partir de uma string de zeros e uns
-    std::vector<std::vector<bool>> matriz_nova(const std::string& str_matrix, int width, int height);
-}   /// namespace area
-
-int main() {
-
-    char xmlfilename[100];
-    std::ifstream xmlfile;
-    
-    std::cin >> xmlfilename;  // entrada
-    
-    xmlfile.open(xmlfilename);
-    /// retorna mensagem de erro e -1 caso o arquivo xml não for aberto
-    if (not xmlfile.is_open()) {
-        std::cout << "error";
-        return -1;
-    }
-    
-    std::stringstream stream;
-  stream << xmlfile.rdbuf();
-  std::string contents = stream.str();
-    
-    xmlfile.close();
-     // retorna mensaegm de erro e -1 caso arquivo não é um xml válido
-    if (not xml::valida(contents)) {
-        std::cout << "error";
-        return -1;
-    }
-    
-    size_t i ={0};
-
-    // busca a tag completa da próxima imagem dentro do arquivo
-    while (i < contents.length()) {
-        std::string open_tag = "<img>";
-        std::string close_tag = "</img>";
-        std::string image = xml::get_tag(contents, open_tag, close_tag, i);
-        i += image.length() + close_tag.length();        
-        // se chegar ao final das imagens ele sai do laço
-        if (i > contents.length()) {
-          break;
-          }
-        /// para buscar o conteudo de cada imagem foi utilizado a função get_value
-        std::string data = xml::get_value(image, "<data>", "</data>");
-        const std::string name = xml::get_value(image, "<name>", "</name>");
-        const int width = std::stoi(xml::get_value(image, "<width>", "</width>"));
-        const int height = std::stoi(xml::get_value(image, "<height>", "</height>"));
-         /// se for uma imagem inválida, com altura e largura menores ou iguais a 0, retorna -1
-        if (height <= 0|| width <= 0) {
-          return -1;
-        }
-         // remove \n da string data
-        data.erase(std::remove(data.begin(), data.end(), '\n'), data.end());
-        std::vector<std::vector<bool>> matrix = area::matriz_nova(data, width, height);
-
-        int regions = area::area_contador(matrix);
-		std::cout << name << ' ' << regions << std::endl;
-    }
-}
-
-namespace xml {
-bool valida(const std::string& contents) {
-    structures::LinkedStack<std::string> tags;
-    size_t i = 0u;
-
-    while (i < contents.length()) {
-        /// encontra o íncio e final da próxima tag 
-        size_t pos_inicial = contents.find('<', i);
-        size_t pos_final = contents.find('>', pos_inicial);
-        /// senão encontrar, pula para o final
-        if (pos_inicial == std::string::npos) {
-            break;
-        }
-        /// se a posição final falhar, ocorre um erro
-        if (pos_final == std::string::npos) {
-            return false;
-        }
-        
-        std::string tag = contents.substr(pos_inicial, pos_final + 1 - pos_inicial);
-        i = pos_final + 1;
-        /// se for uma tag de abertura, vai colocar "/" no inicio da pilha
-        if (tag[1] != '/') {
-            tags.push(tag.insert(1, "/"));
-        } else {
-            /// se for uma tag de fechamento e a pilha está vazia, o arquivo vai ser invalido
-            if (tags.empty()) {
-                return false;
-            /// se a tag de fechamento for igual ao topo da pilha, ele vai desempilhar o topo
-            } else if (tags.top() == tag) {
-                tags.pop();
-            /// caso contrário vai dar erro
-            } else {
-                return false;
-            }  
-        }
-    }
-    return tags.empty();
-}
-
-std::string get_tag(
-    const std::string& source, 
-    const std::string& open_tag, 
-    const std::string& close_tag, 
-    size_t& start_index) {
-
-    size_t pos_inicial = source.find(open_tag, start_index);
-    size_t pos_final = source.find(close_tag, pos_inicial);
-            
-    pos_inicial += open_tag.length();
-    std::string tag_contents = source.substr(pos_inicial, pos_final - pos_inicial);
-    return tag_contents;
-}
-
-std::string get_value(
-    const std::string& source, 
-    const std::string& open_tag, 
-    const std::string& close_tag) {
-
-    std::size_t pos{0};
-    return get_tag(source, open_tag, close_tag, pos);
-}
-}  /// namespace xml
-
-namespace structures {
-template<typename T>
-LinkedStack<T>::LinkedStack() {}
-
-template<typename T>
-LinkedStack<T>::~LinkedStack() {
-    top_ = nullptr;
-    size_ = 0;
-}
-
-template<typename T>
-void LinkedStack<T>::clear() {
-    top_ = nullptr;
-    size_ = 0;
-}
-
-template<typename T>
-void LinkedStack<T>::push(const T& data) {
-    Node* novo = new Node(data, top_);
-    top_ = novo;
-    size_++;
-}
-
-template<typename T>
-T LinkedStack<T>::pop() {
-    if (empty()) {
-        throw std::out_of_range("Empty Stack");
-    }
-    Node* aux = top_;
-    T data = aux->data();
-    top_ = top_->next();
-    size_--;
-    delete aux;
-    return data;
-}
-
-template<typename T>
-T& LinkedStack<T>::top() const {
-    if (empty()) {
-        throw std::out_of_range("Empty Stack");
-    }
-    return top_->data();
-}
-
-template<typename T>
-bool LinkedStack<T>::empty() const {
-    return size_ == 0;
-}
-
-template<typename T>
-std::size_t LinkedStack<T>::size() const {
-    return size_;
-}
-
-}   /// namespace structures
-
-namespace area {
-///metodo que vai transformar uma area que é conexa inteira em uma matriz de zeros, ou seja em pretos
-void area_transformada(std::vector<std::vector<bool>>& matrix, int i, int j) {
-    structures::LinkedStack<std::tuple<int, int>> stack;
-
-    int largura = matrix[0].size();
-    int altura = matrix.size();
-    stack.push(std::make_tuple(i, j));
-
-    while (!stack.empty()) {
-        std::tuple<int, int> aux = stack.pop();
-        
-        i = std::get<0>(aux);
-        j = std::get<1>(aux);
-        matrix[i][j] = 0;
-        /// analisa os elementos da esquerda para ver se existe e sé branco
-        if (j > 0 && matrix[i][j - 1]) {
-            stack.push(std::make_tuple(i, j - 1));     
-        }
-        /// analisa os elementos da direita para ver se existe e sé branco
-        if (j < (largura - 1) && matrix[i][j + 1]) {
-            stack.push(std::make_tuple(i, j + 1));
-        }
-        /// analisa os elementos acima para ver se existe e sé branco
-        if (i > 0 && matrix[i - 1][j]) {
-            stack.push(std::make_tuple(i - 1, j));
-        }
-        /// analisa os elementos abaixo para ver se existe e sé branco
-        if (i < (altura - 1) && matrix[i + 1][j]) {
-            stack.push(std::make_tuple(i + 1, j));
-        }
-    }
-
-} 
-/// método que vai contar as áreas conexas de 1's, e quando encontra ele incrementa um contador, 
-///e depois ele prenche com 0's esses elementos
-int area_contador(std::vector<std::vector<bool>> matrix) {
-    int cont = 0;    
-    for (int i = 0; i < (int) matrix.size(); i++) {
-        for (int j = 0; j < (int) matrix[0].size(); j++) {
-            if (matrix[i][j] == cor::branco) {
-                cont++;
-                area_transformada(matrix, i, j);
-            }
-        }
-    }
-    return cont;
-}
-
-/// metodo que vai criar uma nova matriz apartir dos 0's e 1's
-std::vector<std::vector<bool>> matriz_nova(const std::string& str_matrix, int width, int height) {
-    std::vector<std::vector<bool>> matrix;
-
-    for (int i = 0u; i < height; i++) {
-        std::vector<bool> line;
-        for (int j = 0; j < width; j++) {
-            line.push_back(str_matrix[i * width + j] == '1');
-        }
-        matrix.push_back(line);
-    } 
-    return matrix;
-}
-}   /// namespace area
-
+/// Copyright [2022] <Mauricio Konrath>
+
+#ifndef STRUCTURES_LINKED_STACK_H
+#define STRUCTURES_LINKED_STACK_H
+
+
+#include <iostream> ///ler e gravar
+#include <fstream> ///arquivos
+#include <sstream> ///dados
+#include <tuple> ///tupla
+#include <stack> ///pilha
+#include <string> ///string e memória
+#include <string_view> ///fatias sem cópia
+#include <charconv> ///from_chars
+#include <vector> ///array
+#include <stdexcept> ///exceções em c++
+#include <algorithm> ///intervalos
+#include <utility> /// outras funções
+#include <cstdint> ///std::size_t
+#include <cstring> ///memchr
+#include <cstdio> ///snprintf
+#include <thread> ///threads
+#include <mutex> ///exclusão mútua
+#include <condition_variable> ///espera entre threads
+#include <functional> ///tarefas
+#include <deque> ///fila de tarefas
+#include <optional> ///resultados pendentes
+#include <unordered_map> ///tabela de tags
+#include <exception> ///exceções entre threads
+#include <cctype> ///isspace
+#include <cerrno> ///errno
+#include <atomic> ///contadores entre threads
+#include <chrono> ///relógio
+#include <cstdlib> ///malloc
+#include <limits> ///maior índice
+
+#include <fcntl.h> ///open
+#include <sys/mman.h> ///mmap
+#include <sys/stat.h> ///fstat
+#include <unistd.h> ///close
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> ///SSE2 e AVX2
+#endif
+
+
+/// instrumentação por fase (tempo, bytes, alocações e pixels); só existe quando o
+/// programa é compilado com -DPROJETO_ESTATISTICAS, senão as macros MEDE_* somem
+namespace medicao {
+    /// fases do processamento
+    enum fase {
+        leitura,
+        validacao,
+        extracao,
+        matriz,
+        rotulacao,
+        /// tudo o que acontece fora das fases acima
+        outras,
+        total_fases,
+    };
+    /// formato do relatório
+    enum class formato {
+        nenhum,
+        texto,
+        json,
+    };
+#ifdef PROJETO_ESTATISTICAS
+    /// contadores de uma fase, somados entre todas as threads
+    struct contadores {
+        std::atomic<std::int64_t> nanossegundos{0};
+        std::atomic<std::int64_t> bytes{0};
+        std::atomic<std::int64_t> alocacoes{0};
+        std::atomic<std::int64_t> pixels{0};
+    };
+    contadores& de(fase f); ///contadores da fase f
+    fase atual(); ///fase em que a thread está
+
+    ///classe escopo: coloca a thread na fase até o fim do bloco; o tempo de um escopo
+    ///aninhado não é contado também no de fora
+    class escopo {
+     public:
+        explicit escopo(fase f);
+        ~escopo();
+        escopo(const escopo&) = delete;
+        escopo& operator=(const escopo&) = delete;
+
+     private:
+        fase anterior_;
+    };
+#define MEDE_FASE(f) medicao::escopo medicao_escopo_(f)
+#define MEDE_BYTES(f, n) (medicao::de(f).bytes += static_cast<std::int64_t>(n))
+#define MEDE_PIXELS(f, n) (medicao::de(f).pixels += static_cast<std::int64_t>(n))
+#else
+#define MEDE_FASE(f) ((void)0)
+#define MEDE_BYTES(f, n) ((void)0)
+#define MEDE_PIXELS(f, n) ((void)0)
+#endif
+
+    ///classe relatorio: mostra os contadores na saída de erro quando o programa termina
+    class relatorio {
+     public:
+        explicit relatorio(formato f);
+        ~relatorio();
+
+     private:
+        formato formato_;
+    };
+}   /// namespace medicao
+
+namespace xml {
+///obtem a tag
+std::string get_tag(
+    const std::string& source, 
+    const std::string& open_tag,
+    const std::string& close_tag, 
+    size_t& start_index);
+///obtem o valor
+std::string get_value(
+    const std::string& source,
+    const std::string& open_tag,
+    const std::string& close_tag);
+bool valida(const std::string& contents); ///validar o xml
+///obtem a tag como uma fatia do texto original, sem cópia
+std::string_view get_tag_view(
+    std::string_view source,
+    std::string_view open_tag,
+    std::string_view close_tag,
+    size_t& start_index);
+///obtem o valor como uma fatia do texto original, sem cópia
+std::string_view get_value_view(
+    std::string_view source,
+    std::string_view open_tag,
+    std::string_view close_tag);
+///converte um valor numérico direto da fatia, como std::stoi
+int para_int(std::string_view valor);
+
+/// arquivo de entrada mapeado em memória; se o mmap falhar, lê o arquivo inteiro uma vez
+class arquivo {
+ public:
+    arquivo() = default;
+    ~arquivo();
+    arquivo(const arquivo&) = delete;
+    arquivo& operator=(const arquivo&) = delete;
+    bool abre(const std::string& nome); ///abre e mapeia o arquivo
+    void fecha(); ///libera o mapeamento ou a cópia; dados() deixa de valer
+    const char* dados() const; ///início do conteúdo
+    std::size_t tamanho() const; ///tamanho do conteúdo
+
+ private:
+    void* mapa_{nullptr};
+    std::size_t tamanho_{0u};
+    std::string reserva_;
+};
+
+/// posição [inicio, fim) de um trecho do arquivo; npos se não foi encontrado
+struct fatia {
+    std::size_t inicio{std::string_view::npos};
+    std::size_t fim{std::string_view::npos};
+
+    std::string_view em(const char* contents) const; ///o trecho, ou vazio se faltou
+};
+
+/// posição do conteúdo de uma imagem (entre <img> e </img>) dentro do arquivo, e dos
+/// valores das suas tags, já separados pela varredura
+struct registro {
+    std::size_t inicio;
+    std::size_t fim;
+    fatia name{};
+    fatia width{};
+    fatia height{};
+    fatia data{};
+};
+
+/// tabela que troca cada nome de tag por um número pequeno; guarda uma cópia de
+/// cada nome novo, então continua valendo depois que o texto analisado for descartado
+class tabela_tags {
+ public:
+    static constexpr int IMG = 0; ///número fixo da tag img
+
+    tabela_tags(); ///já começa com a tag img
+    int id(std::string_view nome); ///número da tag, criando um se for nova
+    std::string_view nome(int id) const; ///nome da tag de número id
+
+ private:
+    std::unordered_map<std::string_view, int> ids_;
+    std::deque<std::string> nomes_;
+};
+
+/// pilha de tags abertas, usada para validar o aninhamento tag a tag
+class pilha_tags {
+ public:
+    /// o que uma tag causou
+    enum evento {
+        /// tag comum, válida
+        nenhum,
+        /// abriu uma imagem (fora de outra)
+        abre_imagem,
+        /// fechou a imagem aberta
+        fecha_imagem,
+        /// fechou uma tag diferente da do topo: xml inválido
+        erro,
+    };
+    evento tag(std::string_view texto); ///processa o texto entre '<' e '>'
+    bool empty() const; ///true se todas as tags foram fechadas
+
+ private:
+    tabela_tags tabela_;
+    std::vector<int> tags_;
+    bool em_imagem_{false};
+};
+
+/// leitor incremental: recebe o xml em blocos de qualquer tamanho, mantendo entre um
+/// bloco e outro a tag incompleta e a imagem aberta, e entrega cada imagem assim que
+/// o seu </img> chega; a memória fica limitada pela maior imagem
+class leitor_incremental {
+ public:
+    /// estado depois de cada bloco
+    enum estado {
+        /// pode receber o próximo bloco
+        continua,
+        /// o xml é inválido
+        invalido,
+        /// a função chamada para uma imagem pediu para parar
+        interrompido,
+    };
+    /// ao_fechar recebe o conteúdo de cada imagem e retorna false para parar a leitura
+    explicit leitor_incremental(std::function<bool(std::string_view)> ao_fechar);
+    estado alimenta(const char* dados, std::size_t tamanho); ///processa mais um bloco
+    bool termina() const; ///true se o xml acabou bem formado
+
+ private:
+    std::function<bool(std::string_view)> ao_fechar_;
+    pilha_tags tags_;
+    std::string pendente_; ///texto ainda necessário: tag incompleta ou imagem aberta
+    std::size_t pos_{0u}; ///de onde continuar procurando tags em pendente_
+    std::size_t imagem_{std::string::npos}; ///início do conteúdo da imagem aberta
+};
+
+/// percorre o xml uma única vez, validando o aninhamento e coletando as imagens e os
+/// valores das suas tags; só olha as posições de indexa, não o texto todo
+bool varre(const char* contents, std::size_t tamanho, std::vector<registro>& imagens);
+
+/// tamanho da janela que varre indexa de cada vez: o índice de uma janela cabe no
+/// cache e é consumido antes de indexar a próxima, em vez de indexar o arquivo todo
+constexpr std::size_t janela_indice = 64u * 1024u;
+
+/// índice estrutural, como o primeiro estágio do simdjson: as posições de todos os
+/// '<' e '>' do texto (relativas a dados, que tem no máximo janela_indice bytes), em
+/// ordem, achadas como máscaras de bits em blocos de 64 bytes; escolhe, uma única vez,
+/// a melhor versão suportada pela CPU
+void indexa(const char* dados, std::size_t tamanho, std::vector<std::uint32_t>& posicoes);
+/// monta a máscara de cada bloco um byte por vez
+void indexa_escalar(const char* dados, std::size_t tamanho,
+                    std::vector<std::uint32_t>& posicoes);
+#if defined(__x86_64__) || defined(__i386__)
+/// o mesmo índice, comparando 16 bytes por vez
+void indexa_sse2(const char* dados, std::size_t tamanho, std::vector<std::uint32_t>& posicoes);
+/// o mesmo índice, comparando 32 bytes por vez
+void indexa_avx2(const char* dados, std::size_t tamanho, std::vector<std::uint32_t>& posicoes);
+#endif
+
+} ///namespace xml
+
+namespace structures {
+///classe LinkedStack
+template<typename T>
+class LinkedStack {
+ public:
+    LinkedStack(); ///construtor simples    
+    ~LinkedStack(); ///destrutor    
+    LinkedStack(const LinkedStack&) = delete;
+    LinkedStack& operator=(const LinkedStack&) = delete;
+    void clear(); ///limpa pilha
+    void push(const T& data); /// empilha    
+    T pop(); ///desempilha    
+    T& top() const; ///retorna ao topo    
+    bool empty() const; ///ve se está vazia   
+    std::size_t size() const; ///retorna o tamanho
+ 
+ private:
+    class Node {   
+     public:
+        explicit Node(const T &data) {
+            data_ = data;
+            next_ = nullptr;
+        }
+
+        Node(const T& data, Node* next) {
+            data_ = data;
+            next_ = next;
+        }
+
+        T& data() { /// getter: dado   
+            return data_;
+        }
+
+        const T& data() const { /// getter const: dado  
+            return data_;
+        }
+
+        Node* next() { /// getter: próximo
+            return next_;
+        }
+
+        const Node* next() const { /// getter const: próximo
+            return next_;
+        }
+
+        void next(Node* node) { /// setter: próximo  
+            next_ = node;
+        }
+
+     private:
+        T data_;
+        Node* next_{nullptr};
+    };
+
+    Node* top_{nullptr};
+    Node* livres_{nullptr}; ///nós já desempilhados, reaproveitados pelo push
+    std::size_t size_{0u};
+};
+
+///classe ArrayQueue: fila circular em vetor, com tamanho máximo fixo
+template<typename T>
+class ArrayQueue {
+ public:
+    ArrayQueue(); ///construtor simples
+    explicit ArrayQueue(std::size_t max); ///construtor com tamanho máximo
+    ~ArrayQueue(); ///destrutor
+    ArrayQueue(const ArrayQueue&) = delete;
+    ArrayQueue& operator=(const ArrayQueue&) = delete;
+    void enqueue(const T& data); ///enfileira
+    void enqueue(T&& data); ///enfileira sem copiar
+    T dequeue(); ///desenfileira
+    T& back(); ///retorna o último
+    void clear(); ///limpa a fila
+    std::size_t size() const; ///retorna o tamanho atual
+    std::size_t max_size() const; ///retorna o tamanho máximo
+    bool empty() const; ///ve se está vazia
+    bool full() const; ///ve se está cheia
+
+ private:
+    T* contents;
+    std::size_t size_;
+    std::size_t max_size_;
+    std::size_t begin_; ///índice do início (fila circular)
+    std::size_t end_; ///índice do fim (fila circular)
+    static const auto DEFAULT_SIZE = 10u;
+};
+}   /// namespace structures
+
+namespace area {
+    struct rascunho;
+
+    /// vai enumerar as sequencias dos pixels
+    enum cor {
+        /// 0 para preto
+        preto,
+        /// 1 para branco
+        branco,
+    };
+    /// imagem binária compacta: cada linha ocupa `passo` palavras de 64 bits contíguas,
+    /// e o pixel (i, j) é o bit j % 64 da palavra j / 64 da linha i
+    class bitmap {
+     public:
+        bitmap() = default;
+        bitmap(int largura, int altura); ///cria a imagem toda em preto
+        bitmap(const bitmap& outro); ///cópia sempre com memória própria
+        bitmap(bitmap&& outro) noexcept;
+        bitmap& operator=(bitmap outro) noexcept;
+        /// imagem que só aponta para palavras guardadas em outro lugar (um arquivo
+        /// mapeado, por exemplo), sem copiá-las; só pode ser usada como const
+        static bitmap vista(const std::uint64_t* palavras, int largura, int altura);
+        /// refaz a imagem toda em preto com o novo tamanho, reaproveitando a memória
+        void redimensiona(int largura, int altura);
+        /// copia os pixels de outra imagem, reaproveitando a memória
+        void copia(const bitmap& outro);
+        int largura() const; ///retorna a largura
+        int altura() const; ///retorna a altura
+        std::size_t passo() const; ///palavras por linha
+        bool pixel(int i, int j) const; ///retorna o pixel (i, j)
+        void liga(int i, int j); ///pinta o pixel (i, j) de branco
+        void apaga(int i, int j); ///pinta o pixel (i, j) de preto
+        void apaga(int i, int inicio, int fim); ///pinta de preto as colunas [inicio, fim]
+        std::uint64_t* linha(int i); ///palavras da linha i
+        const std::uint64_t* linha(int i) const; ///palavras da linha i
+
+     private:
+        int largura_{0};
+        int altura_{0};
+        std::size_t passo_{0u};
+        std::uint64_t* palavras_{nullptr}; ///memoria_ ou as palavras de uma vista
+        std::vector<std::uint64_t> memoria_;
+    };
+
+    /// algoritmo usado para encontrar as áreas
+    enum class algoritmo {
+        /// preenche cada área com uma pilha (area_transformada)
+        preenchimento,
+        /// rotula as corridas de cada linha em duas passadas, com união e busca
+        uniao_busca,
+        /// preenche cada área por varredura, uma corrida horizontal inteira por vez
+        varredura,
+        /// corridas achadas palavra por palavra, sobreposições pelo E das linhas (area_bits)
+        bits,
+    };
+
+    /// conjuntos disjuntos de rótulos, com compressão de caminho
+    class uniao_busca {
+     public:
+        void clear(); ///remove todos os conjuntos
+        int novo(); ///cria um conjunto unitário e retorna seu rótulo
+        int busca(int x); ///retorna a raiz do conjunto de x
+        bool une(int a, int b); ///une os conjuntos; false se já eram o mesmo
+        std::size_t size() const; ///quantidade de rótulos criados
+        void anexa(const uniao_busca& outro); ///copia os conjuntos de outro, renumerados
+
+     private:
+        std::vector<int> pai_;
+    };
+
+    /// corrida horizontal de pixels brancos, das colunas inicio até fim (inclusive)
+    struct corrida {
+        int inicio;
+        int fim;
+        int rotulo;
+    };
+
+    /// estatísticas de uma área, acumuladas corrida a corrida durante a rotulação
+    struct componente {
+        std::int64_t area{0}; ///quantidade de pixels
+        int topo{0}; ///caixa envolvente: primeira linha
+        int esquerda{0}; ///caixa envolvente: primeira coluna
+        int base{0}; ///caixa envolvente: última linha
+        int direita{0}; ///caixa envolvente: última coluna
+        std::int64_t soma_linhas{0}; ///soma das linhas de todos os pixels
+        std::int64_t soma_colunas{0}; ///soma das colunas de todos os pixels
+
+        double centro_i() const; ///linha do centróide
+        double centro_j() const; ///coluna do centróide
+        void junta(const componente& outro); ///acumula as estatísticas de outra parte da área
+    };
+
+    /// primeira passada: encontra as corridas das linhas [primeira, ultima), dá um
+    /// rótulo a cada uma e une os rótulos das corridas que se tocam na linha de cima
+    /// (só na vertical com Conectividade 4, também na diagonal com 8);
+    /// em linhas fica o índice da primeira corrida de cada linha, mais o total ao final;
+    /// se estatisticas não for nulo, recebe as estatísticas de cada rótulo;
+    /// retorna quantos conjuntos novos restaram depois das uniões
+    template<int Conectividade = 4>
+    int rotula_corridas(
+        const bitmap& matrix,
+        int primeira,
+        int ultima,
+        uniao_busca& conjuntos,
+        std::vector<corrida>& corridas,
+        std::vector<std::size_t>& linhas,
+        std::vector<componente>* estatisticas = nullptr);
+    /// conta as áreas e calcula as estatísticas de cada uma, na ordem em que
+    /// aparecem na leitura, na mesma passada da rotulação; elas ficam em
+    /// memoria.componentes; se mapa não for nulo, recebe também o mapa de rótulos
+    /// (veja pinta_rotulos)
+    template<int Conectividade>
+    int area_estatisticas(
+        const bitmap& matrix,
+        rascunho& memoria,
+        std::vector<std::uint32_t>* mapa = nullptr);
+    /// monta o mapa de rótulos a partir das corridas já rotuladas, sem olhar os pixels de
+    /// novo: largura * altura valores, linha por linha, 0 no preto e 1, 2, 3... em cada
+    /// área, na ordem em que as áreas aparecem na leitura; numeros é só memória de
+    /// trabalho, com o número de cada raiz
+    void pinta_rotulos(
+        const bitmap& matrix,
+        const std::vector<corrida>& corridas,
+        const std::vector<std::size_t>& linhas,
+        uniao_busca& conjuntos,
+        std::vector<std::uint32_t>& numeros,
+        std::vector<std::uint32_t>& rotulos);
+    /// quantas das `faixas` pedidas valem a pena para a imagem: faixas muito finas
+    /// custam mais para unir do que economizam
+    int faixas_uteis(const bitmap& matrix, int faixas);
+    /// divide a imagem em faixas_uteis faixas horizontais rotuladas em paralelo pela
+    /// thread atual e pelo pool de paralelo::ajudantes_faixas, e depois une as áreas
+    /// que atravessam as bordas entre as faixas; as faixas e os conjuntos unidos
+    /// ficam no rascunho
+    int rotula_faixas(const bitmap& matrix, int faixas, rascunho& memoria);
+    /// vai contar as areas em branco; com o algoritmo de união e busca, imagens grandes
+    /// podem ser divididas em até `faixas` faixas processadas em paralelo
+    int area_contador(
+        const bitmap& matrix,
+        algoritmo modo = algoritmo::preenchimento,
+        int faixas = 1);
+    /// a mesma contagem, pegando a cópia da matriz, as pilhas e os vetores do rascunho;
+    /// se mapa não for nulo, recebe o mapa de rótulos, e então a rotulação é sempre
+    /// por união e busca, numa faixa só, independente do modo
+    int area_contador(
+        const bitmap& matrix,
+        algoritmo modo,
+        int faixas,
+        rascunho& memoria,
+        std::vector<std::uint32_t>* mapa = nullptr);
+    /// vai transformar uma area inteira da matriz em zeros; a pilha é reaproveitada
+    /// entre as áreas
+    void area_transformada(
+        bitmap& matrix,
+        int i,
+        int j,
+        structures::LinkedStack<std::tuple<int, int>>& stack);
+    /// mesmo preenchimento, por varredura: apaga a corrida inteira que contém (i, j) e
+    /// empilha uma semente por corrida branca encostada nela nas linhas de cima e de baixo;
+    /// a pilha é reaproveitada entre as áreas
+    void area_varredura(
+        bitmap& matrix,
+        int i,
+        int j,
+        std::vector<std::pair<int, int>>& pilha);
+    /// grava pixels em sequência no bitmap, passando para a linha seguinte ao fim de cada uma
+    class escritor_bits {
+     public:
+        explicit escritor_bits(bitmap& matrix);
+        /// modo por linhas: grava `altura` linhas, uma de cada vez, na única linha de
+        /// `linha`, chamando ao_completar com ela pronta antes de apagá-la para a seguinte
+        escritor_bits(
+            bitmap& linha,
+            int altura,
+            std::function<void(const std::uint64_t*)> ao_completar);
+        void escreve(std::uint64_t bits, int n); ///grava os n (<= 64) bits mais baixos
+        void completa(); ///preenche de preto o que faltou gravar
+        bool cheio() const; ///true quando todos os pixels já foram gravados
+
+     private:
+        bitmap& matrix_;
+        int altura_;
+        int i_{0};
+        int j_{0};
+        std::uint64_t* linha_;
+        std::function<void(const std::uint64_t*)> ao_completar_;
+    };
+
+    /// rotula a imagem linha por linha, guardando só as corridas da linha anterior e
+    /// as equivalências entre elas; as áreas são contadas assim que não continuam
+    /// na linha seguinte, então a memória é proporcional à largura, não à imagem
+    class rotulador_fluxo {
+     public:
+        explicit rotulador_fluxo(int largura);
+        void reinicia(int largura); ///começa uma nova imagem, mantendo a memória
+        void linha(const std::uint64_t* palavras); ///processa a próxima linha
+        int termina(); ///fecha as áreas restantes e retorna o total
+
+     private:
+        int largura_;
+        int fechadas_{0};
+        int abertas_{0}; ///áreas (rótulos 0..abertas_-1) das corridas da linha anterior
+        std::vector<corrida> anteriores_;
+        std::vector<corrida> atuais_;
+        uniao_busca conjuntos_;
+        std::vector<int> novos_;
+    };
+
+    /// decodifica o texto de '0's e '1's entre p e fim para o escritor, ignorando as
+    /// quebras de linha; retorna até onde o texto foi consumido
+    const char* decodifica_escalar(const char* p, const char* fim, escritor_bits& saida);
+#if defined(__x86_64__) || defined(__i386__)
+    /// mesma decodificação, comparando 16 bytes por vez
+    const char* decodifica_sse2(const char* p, const char* fim, escritor_bits& saida);
+    /// mesma decodificação, comparando 32 bytes por vez
+    const char* decodifica_avx2(const char* p, const char* fim, escritor_bits& saida);
+#endif
+    /// escolhe, uma única vez, a melhor decodificação suportada pela CPU
+    void decodifica(std::string_view str_matrix, escritor_bits& saida);
+    void decodifica(std::string_view str_matrix, bitmap& matrix);
+    /// conta as áreas direto do texto, sem montar a matriz (veja rotulador_fluxo)
+    int area_fluxo(std::string_view str_matrix, int width, int height, rascunho& memoria);
+
+    /// imagem codificada em corridas: para cada linha, só as corridas de pixels brancos,
+    /// da esquerda para a direita; a memória cresce com o número de corridas, não de pixels
+    class imagem_rle {
+     public:
+        imagem_rle() = default;
+        int largura() const; ///retorna a largura
+        int altura() const; ///retorna a altura
+        std::size_t size() const; ///total de corridas
+        const corrida* inicio(int i) const; ///primeira corrida da linha i
+        const corrida* fim(int i) const; ///depois da última corrida da linha i
+        void clear(int largura); ///esvazia a imagem, com a largura dada
+        void nova_linha(); ///começa a próxima linha
+        void adiciona(int inicio, int fim); ///acrescenta uma corrida à linha atual
+
+     private:
+        int largura_{0};
+        std::vector<corrida> corridas_;
+        std::vector<std::size_t> linhas_{0u}; ///índice da primeira corrida de cada linha
+    };
+
+    /// acrescenta à linha atual da imagem as corridas de uma linha do bitmap,
+    /// achadas palavra por palavra com contagem de zeros à direita
+    void extrai_corridas(const std::uint64_t* palavras, int largura, imagem_rle& saida);
+    /// conta as áreas direto nas corridas: duas corridas de linhas vizinhas que se
+    /// sobrepõem pertencem à mesma área; conjuntos é só memória de trabalho
+    int area_rle(const imagem_rle& imagem, uniao_busca& conjuntos);
+    /// conta as áreas do bitmap sem olhar pixel por pixel: as corridas de cada linha saem
+    /// de extrai_corridas, e as partes em que duas linhas vizinhas se tocam saem do E
+    /// das suas palavras; cada trecho contínuo desse E une uma corrida de cima com uma
+    /// de baixo
+    int area_bits(const bitmap& matrix, rascunho& memoria);
+    /// vai criar uma nova matriz a partir de uma string de zeros e uns
+    /// (as quebras de linha do texto são ignoradas)
+    bitmap matriz_nova(std::string_view str_matrix, int width, int height);
+    /// a mesma matriz, escrita em saida e reaproveitando a memória dela
+    void matriz_nova(std::string_view str_matrix, int width, int height, bitmap& saida);
+    /// a mesma matriz, já em corridas; decodifica uma linha por vez em linha, sem
+    /// montar o bitmap
+    void matriz_nova(std::string_view str_matrix, int width, int height, imagem_rle& saida,
+                     bitmap& linha);
+
+    /// uma faixa horizontal de rotula_faixas, com as linhas [primeira, ultima) rotuladas
+    /// à parte
+    struct faixa {
+        int primeira;
+        int ultima;
+        int cont;
+        uniao_busca conjuntos;
+        std::vector<corrida> corridas;
+        std::vector<std::size_t> linhas;
+    };
+
+    /// memória de trabalho de uma thread, reaproveitada de uma imagem para a outra: as
+    /// fases pegam daqui a matriz, as pilhas e os vetores em vez de alocar tudo de novo,
+    /// e depois que a capacidade chega à da maior imagem não há mais alocações
+    struct rascunho {
+        bitmap matriz; ///imagem decodificada
+        bitmap copia; ///cópia apagada pelos preenchimentos
+        bitmap linha; ///uma linha, nos modos que decodificam linha por linha
+        structures::LinkedStack<std::tuple<int, int>> stack; ///area_transformada
+        std::vector<std::pair<int, int>> pilha; ///area_varredura
+        uniao_busca conjuntos;
+        std::vector<corrida> corridas;
+        std::vector<std::size_t> linhas;
+        imagem_rle rle;
+        rotulador_fluxo fluxo{0};
+        std::vector<std::uint32_t> rotulos; ///mapa de rótulos da imagem atual
+        std::vector<std::uint32_t> numeros; ///pinta_rotulos
+        std::vector<componente> estatisticas; ///area_estatisticas: uma por rótulo
+        std::vector<int> indice; ///area_estatisticas: posição de cada raiz
+        std::vector<componente> componentes; ///area_estatisticas: uma por área
+        std::vector<faixa> faixas; ///rotula_faixas; só as primeiras estão em uso
+    };
+    /// o rascunho da thread atual
+    rascunho& rascunho_local();
+}   /// namespace area
+
+/// formato binário com as imagens já decodificadas, para rodar de novo sem analisar o xml;
+/// tudo na ordem de bytes da máquina, e cada bloco começa num múltiplo de 8 bytes:
+///   cabeçalho: "IMGB", versão (u32), quantidade de imagens (u64)
+///   por imagem: tamanho do nome (u32), largura (u32), altura (u32), reservado (u32),
+///               nome completado com zeros até múltiplo de 8, e as passo * altura
+///               palavras (u64) do bitmap, linha por linha, com zero nos bits depois
+///               da largura
+namespace cache {
+    constexpr char MAGICA[4] = {'I', 'M', 'G', 'B'};
+    constexpr std::uint32_t VERSAO = 1u;
+
+    /// imagem lida do arquivo: o nome e os pixels apontam direto para o arquivo mapeado
+    struct imagem {
+        std::string_view nome;
+        area::bitmap pixels;
+    };
+
+    /// true se o conteúdo começa como um arquivo deste formato
+    bool reconhece(const char* dados, std::size_t tamanho);
+    /// lê todas as imagens sem copiar os pixels; retorna false se o arquivo estiver corrompido
+    bool le(const char* dados, std::size_t tamanho, std::vector<imagem>& imagens);
+
+    ///classe gravador: escreve um arquivo de cache imagem por imagem
+    class gravador {
+     public:
+        bool abre(const std::string& nome); ///cria o arquivo e reserva o cabeçalho
+        void adiciona(std::string_view nome, const area::bitmap& pixels); ///grava uma imagem
+        bool fecha(); ///completa o cabeçalho; retorna false se alguma escrita falhou
+
+     private:
+        std::ofstream arquivo_;
+        std::uint64_t quantidade_{0u};
+    };
+}   /// namespace cache
+
+namespace paralelo {
+///classe pool: threads que executam as tarefas de uma fila compartilhada
+class pool {
+ public:
+    explicit pool(int threads); ///cria as threads
+    ~pool(); ///termina as tarefas pendentes e junta as threads
+    void submete(std::function<void()> tarefa); ///enfileira uma tarefa
+    void cancela(); ///descarta as tarefas que ainda não começaram
+    int tamanho() const; ///quantidade de threads
+
+ private:
+    void trabalha(); ///laço de cada thread
+
+    std::vector<std::thread> threads_;
+    std::deque<std::function<void()>> tarefas_;
+    std::mutex mutex_;
+    std::condition_variable aviso_;
+    bool fim_{false};
+};
+
+///classe fila_limitada: ArrayQueue protegida por mutex, que liga as etapas do pipeline;
+///quem coloca numa fila cheia espera, e é isso que limita a memória quando a etapa
+///seguinte atrasa
+template<typename T>
+class fila_limitada {
+ public:
+    explicit fila_limitada(std::size_t capacidade);
+    bool coloca(T dado); ///espera haver espaço; false se a fila foi fechada
+    bool retira(T& dado); ///espera haver um dado; false se fechada e vazia
+    void fecha(); ///não aceita mais dados e acorda quem estiver esperando
+
+ private:
+    structures::ArrayQueue<T> fila_;
+    std::mutex mutex_;
+    std::condition_variable nao_cheia_;
+    std::condition_variable nao_vazia_;
+    bool fechada_{false};
+};
+
+/// pool compartilhado por todas as threads que rotulam imagens em faixas, criado na
+/// primeira chamada com faixas - 1 threads (quem pede também rotula uma faixa), mas
+/// nunca mais que os núcleos da máquina menos um; as faixas a mais são só divisões do
+/// trabalho, pegas por quem estiver livre; assim, com --threads, as faixas não criam
+/// threads a cada imagem nem se multiplicam
+pool& ajudantes_faixas(int faixas);
+}   /// namespace paralelo
+
+namespace saida {
+///classe escritor: junta o texto num buffer grande, reaproveitado, e só chama write quando
+///ele enche ou quando pedido; no modo paralelo, é também onde os resultados que chegam
+///fora de ordem esperam a vez deles
+class escritor {
+ public:
+    explicit escritor(int fd, std::size_t capacidade = 64u * 1024u);
+    ~escritor(); ///grava o que ainda estiver no buffer
+    escritor(const escritor&) = delete;
+    escritor& operator=(const escritor&) = delete;
+    void escreve(std::string_view texto); ///acrescenta o texto, em ordem
+    void linha(std::string_view texto); ///acrescenta o texto e uma quebra de linha
+    void descarrega(); ///grava o buffer inteiro agora
+
+    void inicia_lote(std::size_t total); ///prepara a reordenação dos índices 0..total-1
+    void amplia_lote(std::size_t mais); ///acrescenta mais índices ao fim do lote atual
+    /// entrega a linha de índice dado, em qualquer ordem; com para = true, a saída do
+    /// lote termina antes deste índice
+    void entrega(std::size_t indice, std::string texto, bool para);
+    /// espera todas as linhas do lote saírem, ou o lote parar; retorna quantas saíram
+    std::size_t espera();
+
+ private:
+    void acrescenta(std::string_view texto); ///sem travar o mutex
+    void grava(); ///grava o buffer inteiro, sem travar o mutex
+
+    int fd_;
+    std::size_t capacidade_;
+    std::string buffer_;
+    std::vector<std::optional<std::string>> pendentes_;
+    std::size_t proximo_{0u};
+    std::size_t parada_{0u};
+    std::mutex mutex_;
+    std::condition_variable aviso_;
+};
+
+/// escritor da saída padrão, gravado ao final do programa
+escritor& padrao();
+}   /// namespace saida
+
+namespace programa {
+    /// formato dos arquivos com o mapa de rótulos
+    enum class formato_rotulos {
+        /// imagem PGM binária (P5), com 8 ou 16 bits por pixel conforme o número de áreas
+        pgm,
+        /// só os largura * altura rótulos (u32), na ordem de bytes da máquina
+        binario,
+    };
+    /// opções da linha de comando
+    struct opcoes {
+        area::algoritmo modo{area::algoritmo::preenchimento};
+        int threads{1};
+        int faixas{1};
+        int conectividade{4};
+        bool estatisticas{false};
+        bool fluxo{false};
+        bool rle{false};
+        bool dedup{false};
+        bool incremental{false};
+        bool pipeline{false};
+        medicao::formato estatisticas_fases{medicao::formato::nenhum};
+        std::string destino_cache; ///se não for vazio, só converte o xml para o cache
+        std::vector<std::string> arquivos; ///se não for vazio, processa todos em lote
+        std::string dir_rotulos; ///se não for vazio, grava ali o mapa de rótulos de cada imagem
+        formato_rotulos formato{formato_rotulos::pgm};
+    };
+    /// resultado do processamento de uma imagem
+    struct resultado {
+        std::string linha; ///"nome regiões"
+        bool valido{true}; ///false se a largura ou a altura forem inválidas
+        bool gravou{true}; ///false se o mapa de rótulos não pôde ser gravado
+        std::exception_ptr erro; ///exceção lançada ao processar a imagem
+    };
+    /// lê as opções; retorna false se alguma for inválida, ou se o modo escolhido
+    /// ignoraria alguma delas (como --converte com vários arquivos)
+    bool le_opcoes(int argc, char* argv[], opcoes& saida);
+    /// acrescenta os caminhos listados no manifesto, um por linha; false se não abrir
+    bool le_manifesto(const std::string& nome, std::vector<std::string>& arquivos);
+    /// true se nome é um diretório onde se pode criar arquivos
+    bool diretorio_gravavel(const std::string& nome);
+    ///classe deduplicacao: lembra o resultado de cada conteúdo de imagem já processado,
+    ///pela dispersão de (largura, altura, dados), para não rotular de novo uma imagem
+    ///repetida com outro nome; o conteúdo é sempre comparado antes de reaproveitar;
+    ///guarda no máximo limite_bytes de cópias e resultados, esquecendo os mais antigos,
+    ///para a memória continuar limitada nos modos que leem a entrada aos poucos
+    class deduplicacao {
+     public:
+        explicit deduplicacao(std::size_t limite_bytes = 64u * 1024u * 1024u);
+        /// procura um conteúdo igual; se achar, coloca em texto o resultado sem o nome
+        bool busca(std::string_view data, int width, int height, std::string& texto);
+        /// guarda o resultado (sem o nome); permanente diz se data continua válido até
+        /// o fim do programa (como o arquivo mapeado de uma execução simples); se não
+        /// continuar, o conteúdo é copiado
+        void guarda(std::string_view data, int width, int height, std::string texto,
+                    bool permanente);
+
+     private:
+        /// dispersão rápida, 8 bytes por vez
+        static std::uint64_t dispersao(std::string_view data, int width, int height);
+
+        /// esquece o resultado guardado há mais tempo; sem travar o mutex
+        void descarta_mais_antiga();
+
+        struct entrada {
+            std::string_view data;
+            int width;
+            int height;
+            std::string texto;
+        };
+        /// uma entrada, na ordem em que foi guardada, com a cópia do conteúdo se houver
+        struct guardada {
+            std::uint64_t chave;
+            const char* data;
+            std::size_t bytes; ///cópia mais resultado
+            std::string copia;
+        };
+        std::unordered_multimap<std::uint64_t, entrada> entradas_;
+        std::deque<guardada> ordem_;
+        std::size_t bytes_{0u};
+        std::size_t limite_bytes_;
+        std::mutex mutex_;
+    };
+    /// resultados já calculados, compartilhados por todas as threads
+    deduplicacao& repetidas();
+    /// extrai os campos de uma imagem e conta suas áreas; o texto da imagem é
+    /// descartado depois (modos incremental e pipeline)
+    resultado processa(std::string_view image, const opcoes& opcoes);
+    /// conta as áreas de uma imagem cujos campos xml::varre já separou; permanente diz
+    /// se contents continua válido até o fim do programa
+    resultado processa(const char* contents, const xml::registro& imagem,
+                       const opcoes& opcoes, bool permanente);
+    /// valida a largura e a altura e conta as áreas (ou reaproveita uma contagem repetida)
+    resultado processa_campos(std::string_view name, std::string_view data,
+                              std::string_view width, std::string_view height,
+                              const opcoes& opcoes, bool permanente);
+    /// conta as áreas de uma imagem a partir do texto dos seus pixels
+    resultado conta_texto(std::string_view name, std::string_view data, int width, int height,
+                          const opcoes& opcoes);
+    /// conta as áreas de uma imagem já decodificada
+    resultado conta(std::string_view name, const area::bitmap& matrix, const opcoes& opcoes);
+    /// grava o mapa de rótulos da imagem em dir_rotulos, num arquivo com o nome da imagem;
+    /// retorna false se não conseguir (escrita falhou, ou áreas demais para um PGM)
+    bool grava_rotulos(std::string_view name, int width, int height, int regions,
+                       const std::vector<std::uint32_t>& rotulos, const opcoes& opcoes);
+    /// processa as tarefas 0..total-1, em paralelo se pedido, e escreve os resultados
+    /// na ordem; retorna o código de saída do programa
+    int executa(std::size_t total, std::function<resultado(std::size_t)> tarefa,
+                const opcoes& opcoes);
+    /// grava as imagens do xml no formato do cache; retorna o código de saída do programa
+    int converte(const char* contents, const std::vector<xml::registro>& imagens,
+                 const std::string& destino);
+    /// lê o xml da entrada padrão em blocos e escreve cada resultado assim que a
+    /// imagem fecha; retorna o código de saída do programa
+    int processa_incremental(const opcoes& opcoes);
+    /// processa vários arquivos num só processo, com as mesmas threads para todos; cada
+    /// linha começa com o nome do arquivo, e um arquivo com erro não interrompe os outros
+    int processa_lote(const opcoes& opcoes);
+    /// processa o xml em três etapas ligadas por filas limitadas, cada uma na sua thread:
+    /// leitura do arquivo em blocos, separação das imagens e contagem das áreas; a
+    /// leitura do disco se sobrepõe à contagem; retorna o código de saída do programa
+    int processa_pipeline(const std::string& nome, const opcoes& opcoes);
+}   /// namespace programa
+
+/// o benchmark inclui este arquivo e define PROJETO_SEM_MAIN para usar seu próprio main
+#ifndef PROJETO_SEM_MAIN
+int main(int argc, char* argv[]) {
+
+    programa::opcoes opcoes;
+    if (not programa::le_opcoes(argc, argv, opcoes)) {
+        std::cerr << "uso: " << argv[0]
+                  << " [--algoritmo preenchimento|uniao|varredura|bits] [--threads N] [--faixas N]"
+                  << " [--conectividade 4|8] [--estatisticas] [--fluxo] [--rle] [--dedup]"
+                  << " [--incremental] [--pipeline] [--lote manifesto] [arquivos...]"
+                  << " [--converte destino] [--rotulos dir] [--formato-rotulos pgm|bin]"
+                  << " [--stats[=json]]" << std::endl;
+        return -1;
+    }
+    /// mostra os contadores das fases em qualquer saída do main
+    medicao::relatorio relatorio(opcoes.estatisticas_fases);
+
+    /// o diretório dos mapas de rótulos é conferido antes de qualquer imagem
+    if (not opcoes.dir_rotulos.empty() && not programa::diretorio_gravavel(opcoes.dir_rotulos)) {
+        saida::padrao().escreve("error");
+        return -1;
+    }
+
+    /// o próprio xml chega pela entrada padrão, em vez do nome do arquivo
+    if (opcoes.incremental) {
+        return programa::processa_incremental(opcoes);
+    }
+
+    /// os nomes dos arquivos vieram na linha de comando ou num manifesto
+    if (not opcoes.arquivos.empty()) {
+        return programa::processa_lote(opcoes);
+    }
+
+    std::string xmlfilename;
+    xml::arquivo xmlfile;
+    
+    std::cin >> xmlfilename;  // entrada
+
+    if (opcoes.pipeline) {
+        return programa::processa_pipeline(xmlfilename, opcoes);
+    }
+    
+    /// retorna mensagem de erro e -1 caso o arquivo xml não for aberto
+    if (not xmlfile.abre(xmlfilename)) {
+        saida::padrao().escreve("error");
+        return -1;
+    }
+    
+    const char* contents = xmlfile.dados();
+
+    /// um cache binário já tem as imagens decodificadas: vai direto para a contagem
+    if (cache::reconhece(contents, xmlfile.tamanho())) {
+        std::vector<cache::imagem> imagens;
+        if (not cache::le(contents, xmlfile.tamanho(), imagens)) {
+            saida::padrao().escreve("error");
+            return -1;
+        }
+        return programa::executa(imagens.size(), [&imagens, &opcoes](std::size_t k) {
+            return programa::conta(imagens[k].nome, imagens[k].pixels, opcoes);
+        }, opcoes);
+    }
+
+    std::vector<xml::registro> imagens;
+
+     // valida o xml e encontra as imagens na mesma passada;
+     // retorna mensaegm de erro e -1 caso arquivo não é um xml válido
+    if (not xml::varre(contents, xmlfile.tamanho(), imagens)) {
+        saida::padrao().escreve("error");
+        return -1;
+    }
+
+    if (not opcoes.destino_cache.empty()) {
+        return programa::converte(contents, imagens, opcoes.destino_cache);
+    }
+
+    return programa::executa(imagens.size(), [contents, &imagens, &opcoes](std::size_t k) {
+        /// o arquivo fica mapeado até o fim do programa
+        return programa::processa(contents, imagens[k], opcoes, true);
+    }, opcoes);
+}
+#endif
+
+namespace xml {
+bool valida(const std::string& contents) {
+    std::vector<registro> imagens;
+    return varre(contents.data(), contents.length(), imagens);
+}
+
+tabela_tags::tabela_tags() {
+    id("img");
+}
+
+int tabela_tags::id(std::string_view nome) {
+    auto posicao = ids_.find(nome);
+    if (posicao != ids_.end()) {
+        return posicao->second;
+    }
+    /// a chave aponta para a cópia guardada, que não muda de lugar no deque
+    nomes_.emplace_back(nome);
+    const int novo = static_cast<int>(nomes_.size()) - 1;
+    ids_.emplace(nomes_.back(), novo);
+    return novo;
+}
+
+std::string_view tabela_tags::nome(int id) const {
+    return nomes_[id];
+}
+
+pilha_tags::evento pilha_tags::tag(std::string_view texto) {
+    /// se for uma tag de abertura, vai empilhar o número dela
+    if (texto.empty() || texto[0] != '/') {
+        const int tag = tabela_.id(texto);
+        tags_.push_back(tag);
+        if (not em_imagem_ && tag == tabela_tags::IMG) {
+            em_imagem_ = true;
+            return abre_imagem;
+        }
+        return nenhum;
+    }
+    texto.remove_prefix(1);
+    /// se for uma tag de fechamento e a pilha está vazia, o arquivo vai ser invalido
+    if (tags_.empty()) {
+        return erro;
+    }
+    /// se a tag de fechamento for igual ao topo da pilha, ele vai desempilhar o topo;
+    /// basta comparar com o nome do topo, sem consultar a tabela
+    const int topo = tags_.back();
+    if (tabela_.nome(topo) != texto) {
+        /// caso contrário vai dar erro
+        return erro;
+    }
+    tags_.pop_back();
+    if (em_imagem_ && topo == tabela_tags::IMG) {
+        em_imagem_ = false;
+        return fecha_imagem;
+    }
+    return nenhum;
+}
+
+bool pilha_tags::empty() const {
+    return tags_.empty();
+}
+
+leitor_incremental::leitor_incremental(std::function<bool(std::string_view)> ao_fechar) :
+    ao_fechar_{std::move(ao_fechar)}
+{}
+
+leitor_incremental::estado leitor_incremental::alimenta(const char* dados, std::size_t tamanho) {
+    MEDE_FASE(medicao::validacao);
+    MEDE_BYTES(medicao::validacao, tamanho);
+    pendente_.append(dados, tamanho);
+
+    while (pos_ < pendente_.length()) {
+        const std::size_t pos_inicial = pendente_.find('<', pos_);
+        if (pos_inicial == std::string::npos) {
+            pos_ = pendente_.length();
+            break;
+        }
+        const std::size_t pos_final = pendente_.find('>', pos_inicial);
+        /// tag incompleta: espera o próximo bloco a partir do '<'
+        if (pos_final == std::string::npos) {
+            pos_ = pos_inicial;
+            break;
+        }
+        pos_ = pos_final + 1;
+
+        const std::string_view texto(pendente_.data() + pos_inicial + 1,
+                                     pos_final - pos_inicial - 1);
+        const pilha_tags::evento e = tags_.tag(texto);
+        if (e == pilha_tags::erro) {
+            return invalido;
+        }
+        if (e == pilha_tags::abre_imagem) {
+            imagem_ = pos_;
+        } else if (e == pilha_tags::fecha_imagem) {
+            const std::string_view image(pendente_.data() + imagem_, pos_inicial - imagem_);
+            imagem_ = std::string::npos;
+            if (not ao_fechar_(image)) {
+                return interrompido;
+            }
+        }
+    }
+
+    /// descarta o que já foi consumido e não pertence à imagem aberta
+    const std::size_t descarta = std::min(imagem_, pos_);
+    pendente_.erase(0, descarta);
+    pos_ -= descarta;
+    if (imagem_ != std::string::npos) {
+        imagem_ -= descarta;
+    }
+    return continua;
+}
+
+bool leitor_incremental::termina() const {
+    /// não pode sobrar tag incompleta nem tag aberta
+    return pos_ == pendente_.length() && tags_.empty();
+}
+
+bool varre(const char* contents, std::size_t tamanho, std::vector<registro>& imagens) {
+    MEDE_FASE(medicao::validacao);
+    MEDE_BYTES(medicao::validacao, tamanho);
+    std::vector<std::uint32_t> posicoes;
+
+    pilha_tags tags;
+    /// imagem aberta, com o início do conteúdo e os valores já encontrados
+    registro atual{0u, 0u};
+    auto campo = [&atual](std::string_view nome) -> fatia* {
+        if (nome == "data") {
+            return &atual.data;
+        } else if (nome == "name") {
+            return &atual.name;
+        } else if (nome == "width") {
+            return &atual.width;
+        } else if (nome == "height") {
+            return &atual.height;
+        }
+        return nullptr;
+    };
+
+    /// '<' da tag aberta, que pode ter começado numa janela anterior
+    std::size_t pos_inicial = std::string::npos;
+    for (std::size_t base = 0u; base < tamanho; base += janela_indice) {
+        indexa(contents + base, std::min(janela_indice, tamanho - base), posicoes);
+        for (const std::uint32_t relativa : posicoes) {
+            const std::size_t pos = base + relativa;
+            if (pos_inicial == std::string::npos) {
+                /// encontra o íncio da próxima tag; um '>' solto fora das tags é texto
+                if (contents[pos] == '<') {
+                    pos_inicial = pos;
+                }
+                continue;
+            }
+            /// um '<' dentro da tag também é só texto, como na busca com memchr
+            if (contents[pos] != '>') {
+                continue;
+            }
+            const std::size_t pos_final = pos;
+
+            const std::string_view texto(contents + pos_inicial + 1,
+                                         pos_final - pos_inicial - 1);
+            const pilha_tags::evento e = tags.tag(texto);
+            if (e == pilha_tags::erro) {
+                return false;
+            }
+            if (e == pilha_tags::abre_imagem) {
+                atual = registro{pos_final + 1, 0u};
+            } else if (e == pilha_tags::fecha_imagem) {
+                /// ao fechar uma imagem, guarda a posição do seu conteúdo
+                atual.fim = pos_inicial;
+                imagens.push_back(atual);
+                atual = registro{0u, 0u};
+            } else if (atual.inicio != 0u && not texto.empty()) {
+                /// dentro da imagem: o primeiro valor de cada campo, até o primeiro
+                /// fechamento depois dele, como em get_value_view
+                if (texto[0] != '/') {
+                    fatia* f = campo(texto);
+                    if (f != nullptr && f->inicio == std::string_view::npos) {
+                        f->inicio = pos_final + 1;
+                    }
+                } else {
+                    fatia* f = campo(texto.substr(1));
+                    if (f != nullptr && f->inicio != std::string_view::npos
+                        && f->fim == std::string_view::npos) {
+                        f->fim = pos_inicial;
+                    }
+                }
+            }
+            pos_inicial = std::string::npos;
+        }
+    }
+    /// se a posição final falhar, ocorre um erro
+    if (pos_inicial != std::string::npos) {
+        return false;
+    }
+    return tags.empty();
+}
+
+std::string_view fatia::em(const char* contents) const {
+    if (inicio == std::string_view::npos || fim == std::string_view::npos) {
+        return std::string_view();
+    }
+    return std::string_view(contents + inicio, fim - inicio);
+}
+
+namespace {
+/// acrescenta a posição de cada bit ligado da máscara, a partir de base
+inline void acrescenta_posicoes(std::uint64_t mascara, std::size_t base,
+                                std::vector<std::uint32_t>& posicoes) {
+    while (mascara != 0u) {
+        posicoes.push_back(static_cast<std::uint32_t>(base + __builtin_ctzll(mascara)));
+        mascara &= mascara - 1u;
+    }
+}
+
+/// máscara dos '<' e '>' de um bloco de 64 bytes, um byte por vez
+inline std::uint64_t estrutura_escalar(const char* bloco) {
+    std::uint64_t mascara = 0u;
+    for (int k = 0; k < 64; k++) {
+        if (bloco[k] == '<' || bloco[k] == '>') {
+            mascara |= std::uint64_t{1} << k;
+        }
+    }
+    return mascara;
+}
+
+/// o último bloco incompleto, a partir de base, é completado com espaços
+inline void indexa_resto(const char* dados, std::size_t base, std::size_t tamanho,
+                         std::vector<std::uint32_t>& posicoes) {
+    if (base < tamanho) {
+        char resto[64];
+        std::memset(resto, ' ', sizeof(resto));
+        std::memcpy(resto, dados + base, tamanho - base);
+        acrescenta_posicoes(estrutura_escalar(resto), base, posicoes);
+    }
+}
+}   /// namespace
+
+void indexa_escalar(const char* dados, std::size_t tamanho, std::vector<std::uint32_t>& posicoes) {
+    std::size_t base = 0u;
+    for (; base + 64u <= tamanho; base += 64u) {
+        acrescenta_posicoes(estrutura_escalar(dados + base), base, posicoes);
+    }
+    indexa_resto(dados, base, tamanho, posicoes);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+void indexa_sse2(const char* dados, std::size_t tamanho, std::vector<std::uint32_t>& posicoes) {
+    const __m128i abre = _mm_set1_epi8('<');
+    const __m128i fecha = _mm_set1_epi8('>');
+    std::size_t base = 0u;
+    for (; base + 64u <= tamanho; base += 64u) {
+        std::uint64_t mascara = 0u;
+        for (int k = 0; k < 4; k++) {
+            const __m128i v = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(dados + base + 16 * k));
+            const __m128i tags = _mm_or_si128(_mm_cmpeq_epi8(v, abre),
+                                              _mm_cmpeq_epi8(v, fecha));
+            mascara |= static_cast<std::uint64_t>(
+                static_cast<unsigned>(_mm_movemask_epi8(tags))) << (16 * k);
+        }
+        acrescenta_posicoes(mascara, base, posicoes);
+    }
+    indexa_resto(dados, base, tamanho, posicoes);
+}
+
+/// tags de 32 bytes: 0xff em cada '<' ou '>'
+__attribute__((target("avx2")))
+inline __m256i tags_avx2(const char* p, __m256i abre, __m256i fecha) {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    return _mm256_or_si256(_mm256_cmpeq_epi8(v, abre), _mm256_cmpeq_epi8(v, fecha));
+}
+
+/// máscara de 64 bits de dois resultados de tags_avx2
+__attribute__((target("avx2")))
+inline std::uint64_t mascara_avx2(__m256i baixo, __m256i alto) {
+    return static_cast<std::uint32_t>(_mm256_movemask_epi8(baixo))
+        | static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(alto)))
+            << 32;
+}
+
+__attribute__((target("avx2")))
+void indexa_avx2(const char* dados, std::size_t tamanho, std::vector<std::uint32_t>& posicoes) {
+    const __m256i abre = _mm256_set1_epi8('<');
+    const __m256i fecha = _mm256_set1_epi8('>');
+    std::size_t base = 0u;
+    /// dois blocos por vez: quase todos são só pixels, e um único teste descarta os dois
+    for (; base + 128u <= tamanho; base += 128u) {
+        const __m256i t0 = tags_avx2(dados + base, abre, fecha);
+        const __m256i t1 = tags_avx2(dados + base + 32u, abre, fecha);
+        const __m256i t2 = tags_avx2(dados + base + 64u, abre, fecha);
+        const __m256i t3 = tags_avx2(dados + base + 96u, abre, fecha);
+        const __m256i todos = _mm256_or_si256(_mm256_or_si256(t0, t1), _mm256_or_si256(t2, t3));
+        if (not _mm256_testz_si256(todos, todos)) {
+            acrescenta_posicoes(mascara_avx2(t0, t1), base, posicoes);
+            acrescenta_posicoes(mascara_avx2(t2, t3), base + 64u, posicoes);
+        }
+    }
+    if (base + 64u <= tamanho) {
+        acrescenta_posicoes(mascara_avx2(tags_avx2(dados + base, abre, fecha),
+                                         tags_avx2(dados + base + 32u, abre, fecha)),
+                            base, posicoes);
+        base += 64u;
+    }
+    indexa_resto(dados, base, tamanho, posicoes);
+}
+#endif
+
+void indexa(const char* dados, std::size_t tamanho, std::vector<std::uint32_t>& posicoes) {
+    using indexador = void (*)(const char*, std::size_t, std::vector<std::uint32_t>&);
+    /// escolhe uma única vez, como em area::decodifica
+    static const indexador melhor = []() -> indexador {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return indexa_avx2;
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return indexa_sse2;
+        }
+#endif
+        return indexa_escalar;
+    }();
+
+    posicoes.clear();
+    melhor(dados, tamanho, posicoes);
+}
+
+arquivo::~arquivo() {
+    fecha();
+}
+
+void arquivo::fecha() {
+    if (mapa_ != nullptr) {
+        munmap(mapa_, tamanho_);
+        mapa_ = nullptr;
+    }
+    std::string().swap(reserva_);
+    tamanho_ = 0u;
+}
+
+bool arquivo::abre(const std::string& nome) {
+    /// com mmap, a leitura de verdade acontece nas faltas de página da validação
+    MEDE_FASE(medicao::leitura);
+    int fd = ::open(nome.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* mapa = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapa != MAP_FAILED) {
+            /// a leitura é sequencial, então o kernel pode ler adiante e descartar o que passou
+            madvise(mapa, info.st_size, MADV_SEQUENTIAL);
+            mapa_ = mapa;
+            tamanho_ = info.st_size;
+            MEDE_BYTES(medicao::leitura, tamanho_);
+            ::close(fd);
+            return true;
+        }
+    }
+    ::close(fd);
+
+    /// sem mmap (pipe, arquivo vazio...), lê o arquivo inteiro uma única vez
+    std::ifstream xmlfile(nome, std::ios::binary);
+    if (not xmlfile.is_open()) {
+        return false;
+    }
+    std::stringstream stream;
+    stream << xmlfile.rdbuf();
+    reserva_ = std::move(stream).str();
+    tamanho_ = reserva_.length();
+    MEDE_BYTES(medicao::leitura, tamanho_);
+    return true;
+}
+
+const char* arquivo::dados() const {
+    return mapa_ != nullptr ? static_cast<const char*>(mapa_) : reserva_.data();
+}
+
+std::size_t arquivo::tamanho() const {
+    return tamanho_;
+}
+
+std::string get_tag(
+    const std::string& source, 
+    const std::string& open_tag, 
+    const std::string& close_tag, 
+    size_t& start_index) {
+
+    size_t pos_inicial = source.find(open_tag, start_index);
+    size_t pos_final = source.find(close_tag, pos_inicial);
+            
+    pos_inicial += open_tag.length();
+    std::string tag_contents = source.substr(pos_inicial, pos_final - pos_inicial);
+    return tag_contents;
+}
+
+std::string get_value(
+    const std::string& source, 
+    const std::string& open_tag, 
+    const std::string& close_tag) {
+
+    std::size_t pos{0};
+    return get_tag(source, open_tag, close_tag, pos);
+}
+
+std::string_view get_tag_view(
+    std::string_view source,
+    std::string_view open_tag,
+    std::string_view close_tag,
+    size_t& start_index) {
+
+    size_t pos_inicial = source.find(open_tag, start_index);
+    /// se não encontrar a tag, devolve uma fatia vazia
+    if (pos_inicial == std::string_view::npos) {
+        return std::string_view();
+    }
+    pos_inicial += open_tag.length();
+    size_t pos_final = source.find(close_tag, pos_inicial);
+    if (pos_final == std::string_view::npos) {
+        return std::string_view();
+    }
+    return source.substr(pos_inicial, pos_final - pos_inicial);
+}
+
+std::string_view get_value_view(
+    std::string_view source,
+    std::string_view open_tag,
+    std::string_view close_tag) {
+
+    std::size_t pos{0};
+    return get_tag_view(source, open_tag, close_tag, pos);
+}
+
+int para_int(std::string_view valor) {
+    /// ignora os espaços iniciais, como o std::stoi
+    size_t i = 0u;
+    while (i < valor.length() && std::isspace(static_cast<unsigned char>(valor[i]))) {
+        i++;
+    }
+    const char* inicio = valor.data() + i;
+    const char* fim = valor.data() + valor.length();
+    if (inicio != fim && *inicio == '+') {
+        ++inicio;
+    }
+    int numero = 0;
+    std::from_chars_result r = std::from_chars(inicio, fim, numero);
+    if (r.ec == std::errc::invalid_argument) {
+        throw std::invalid_argument("para_int");
+    }
+    if (r.ec == std::errc::result_out_of_range) {
+        throw std::out_of_range("para_int");
+    }
+    return numero;
+}
+}  /// namespace xml
+
+namespace structures {
+template<typename T>
+LinkedStack<T>::LinkedStack() {}
+
+template<typename T>
+LinkedStack<T>::~LinkedStack() {
+    clear();
+    while (livres_ != nullptr) {
+        Node* aux = livres_;
+        livres_ = livres_->next();
+        delete aux;
+    }
+}
+
+template<typename T>
+void LinkedStack<T>::clear() {
+    /// os nós vão para a lista de livres, para os próximos push
+    while (top_ != nullptr) {
+        Node* aux = top_;
+        top_ = top_->next();
+        aux->next(livres_);
+        livres_ = aux;
+    }
+    size_ = 0;
+}
+
+template<typename T>
+void LinkedStack<T>::push(const T& data) {
+    Node* novo;
+    if (livres_ != nullptr) {
+        novo = livres_;
+        livres_ = livres_->next();
+        novo->data() = data;
+        novo->next(top_);
+    } else {
+        novo = new Node(data, top_);
+    }
+    top_ = novo;
+    size_++;
+}
+
+template<typename T>
+T LinkedStack<T>::pop() {
+    if (empty()) {
+        throw std::out_of_range("Empty Stack");
+    }
+    Node* aux = top_;
+    T data = aux->data();
+    top_ = top_->next();
+    size_--;
+    aux->next(livres_);
+    livres_ = aux;
+    return data;
+}
+
+template<typename T>
+T& LinkedStack<T>::top() const {
+    if (empty()) {
+        throw std::out_of_range("Empty Stack");
+    }
+    return top_->data();
+}
+
+template<typename T>
+bool LinkedStack<T>::empty() const {
+    return size_ == 0;
+}
+
+template<typename T>
+std::size_t LinkedStack<T>::size() const {
+    return size_;
+}
+
+template<typename T>
+ArrayQueue<T>::ArrayQueue() : ArrayQueue(DEFAULT_SIZE) {}
+
+template<typename T>
+ArrayQueue<T>::ArrayQueue(std::size_t max) {
+    max_size_ = max;
+    contents = new T[max_size_];
+    size_ = 0;
+    begin_ = 0;
+    end_ = max_size_ - 1;
+}
+
+template<typename T>
+ArrayQueue<T>::~ArrayQueue() {
+    delete[] contents;
+}
+
+template<typename T>
+void ArrayQueue<T>::enqueue(const T& data) {
+    enqueue(T(data));
+}
+
+template<typename T>
+void ArrayQueue<T>::enqueue(T&& data) {
+    if (full()) {
+        throw std::out_of_range("fila cheia!");
+    }
+    end_ = (end_ + 1) % max_size_;
+    contents[end_] = std::move(data);
+    size_++;
+}
+
+template<typename T>
+T ArrayQueue<T>::dequeue() {
+    if (empty()) {
+        throw std::out_of_range("fila vazia!");
+    }
+    T aux = std::move(contents[begin_]);
+    begin_ = (begin_ + 1) % max_size_;
+    size_--;
+    return aux;
+}
+
+template<typename T>
+T& ArrayQueue<T>::back() {
+    if (empty()) {
+        throw std::out_of_range("fila vazia");
+    }
+    return contents[end_];
+}
+
+template<typename T>
+void ArrayQueue<T>::clear() {
+    size_ = 0;
+    begin_ = 0;
+    end_ = max_size_ - 1;
+}
+
+template<typename T>
+std::size_t ArrayQueue<T>::size() const {
+    return size_;
+}
+
+template<typename T>
+std::size_t ArrayQueue<T>::max_size() const {
+    return max_size_;
+}
+
+template<typename T>
+bool ArrayQueue<T>::empty() const {
+    return size() == 0;
+}
+
+template<typename T>
+bool ArrayQueue<T>::full() const {
+    return size() == max_size();
+}
+
+}   /// namespace structures
+
+namespace programa {
+bool le_opcoes(int argc, char* argv[], opcoes& saida) {
+    for (int i = 1; i < argc; i++) {
+        const std::string_view opcao = argv[i];
+        if (opcao == "--algoritmo" && i + 1 < argc) {
+            const std::string_view valor = argv[++i];
+            if (valor == "preenchimento") {
+                saida.modo = area::algoritmo::preenchimento;
+            } else if (valor == "uniao") {
+                saida.modo = area::algoritmo::uniao_busca;
+            } else if (valor == "varredura") {
+                saida.modo = area::algoritmo::varredura;
+            } else if (valor == "bits") {
+                saida.modo = area::algoritmo::bits;
+            } else {
+                return false;
+            }
+        } else if (opcao == "--estatisticas") {
+            saida.estatisticas = true;
+        } else if (opcao == "--fluxo") {
+            saida.fluxo = true;
+        } else if (opcao == "--rle") {
+            saida.rle = true;
+        } else if (opcao == "--dedup") {
+            saida.dedup = true;
+        } else if (opcao == "--incremental") {
+            saida.incremental = true;
+        } else if (opcao == "--pipeline") {
+            saida.pipeline = true;
+        } else if (opcao == "--stats") {
+            saida.estatisticas_fases = medicao::formato::texto;
+        } else if (opcao == "--stats=json") {
+            saida.estatisticas_fases = medicao::formato::json;
+        } else if (opcao == "--converte" && i + 1 < argc) {
+            saida.destino_cache = argv[++i];
+        } else if (opcao == "--rotulos" && i + 1 < argc) {
+            saida.dir_rotulos = argv[++i];
+        } else if (opcao == "--formato-rotulos" && i + 1 < argc) {
+            const std::string_view valor = argv[++i];
+            if (valor == "pgm") {
+                saida.formato = formato_rotulos::pgm;
+            } else if (valor == "bin") {
+                saida.formato = formato_rotulos::binario;
+            } else {
+                return false;
+            }
+        } else if (opcao == "--lote" && i + 1 < argc) {
+            if (not le_manifesto(argv[++i], saida.arquivos)) {
+                return false;
+            }
+        } else if (opcao.substr(0, 2) != "--") {
+            saida.arquivos.emplace_back(opcao);
+        } else if (opcao == "--conectividade" && i + 1 < argc) {
+            const std::string_view valor = argv[++i];
+            if (valor == "4") {
+                saida.conectividade = 4;
+            } else if (valor == "8") {
+                saida.conectividade = 8;
+            } else {
+                return false;
+            }
+        } else if ((opcao == "--threads" || opcao == "--faixas") && i + 1 < argc) {
+            const std::string_view valor = argv[++i];
+            int& numero = opcao == "--threads" ? saida.threads : saida.faixas;
+            std::from_chars_result r = std::from_chars(
+                valor.data(), valor.data() + valor.length(), numero);
+            if (r.ec != std::errc() || r.ptr != valor.data() + valor.length() || numero < 1) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    /// o lote, o pipeline e o modo incremental leem a entrada cada um do seu jeito, e
+    /// só a execução simples converte para o cache; o modo incremental é sempre serial
+    const bool lote = not saida.arquivos.empty();
+    if (not saida.destino_cache.empty() && (lote || saida.pipeline || saida.incremental)) {
+        return false;
+    }
+    if (saida.incremental && (lote || saida.pipeline || saida.threads > 1)) {
+        return false;
+    }
+    if (saida.pipeline && lote) {
+        return false;
+    }
+    return true;
+}
+
+bool diretorio_gravavel(const std::string& nome) {
+    struct stat info;
+    return ::stat(nome.c_str(), &info) == 0 && S_ISDIR(info.st_mode)
+        && ::access(nome.c_str(), W_OK | X_OK) == 0;
+}
+
+bool le_manifesto(const std::string& nome, std::vector<std::string>& arquivos) {
+    std::ifstream manifesto(nome);
+    if (not manifesto.is_open()) {
+        return false;
+    }
+    std::string linha;
+    while (std::getline(manifesto, linha)) {
+        /// ignora linhas em branco e espaços nas pontas
+        const std::size_t inicio = linha.find_first_not_of(" \t\r");
+        if (inicio == std::string::npos) {
+            continue;
+        }
+        const std::size_t fim = linha.find_last_not_of(" \t\r");
+        arquivos.push_back(linha.substr(inicio, fim - inicio + 1));
+    }
+    return true;
+}
+
+resultado processa(std::string_view image, const opcoes& opcoes) {
+    std::string_view data;
+    std::string_view name;
+    std::string_view width;
+    std::string_view height;
+    {
+        MEDE_FASE(medicao::extracao);
+        MEDE_BYTES(medicao::extracao, image.length());
+        /// para buscar o conteudo de cada imagem foi utilizado a função get_value_view,
+        /// que devolve fatias do arquivo sem copiar
+        data = xml::get_value_view(image, "<data>", "</data>");
+        name = xml::get_value_view(image, "<name>", "</name>");
+        width = xml::get_value_view(image, "<width>", "</width>");
+        height = xml::get_value_view(image, "<height>", "</height>");
+    }
+    return processa_campos(name, data, width, height, opcoes, false);
+}
+
+resultado processa(const char* contents, const xml::registro& imagem, const opcoes& opcoes,
+                   bool permanente) {
+    /// a varredura já achou os valores pelo índice de tags: não há mais texto a procurar
+    return processa_campos(imagem.name.em(contents), imagem.data.em(contents),
+                           imagem.width.em(contents), imagem.height.em(contents), opcoes,
+                           permanente);
+}
+
+resultado processa_campos(std::string_view name, std::string_view data,
+                          std::string_view width_texto, std::string_view height_texto,
+                          const opcoes& opcoes, bool permanente) {
+    resultado saida;
+    try {
+        const int width = xml::para_int(width_texto);
+        const int height = xml::para_int(height_texto);
+        if (height <= 0|| width <= 0) {
+            saida.valido = false;
+            return saida;
+        }
+        std::string texto;
+        /// com o mapa de rótulos, cada imagem precisa ser rotulada para gravar o seu
+        const bool dedup = opcoes.dedup && opcoes.dir_rotulos.empty();
+        if (dedup && repetidas().busca(data, width, height, texto)) {
+            saida.linha.append(name).append(1, ' ').append(texto);
+            return saida;
+        }
+        saida = conta_texto(name, data, width, height, opcoes);
+        if (dedup && saida.valido && not saida.erro) {
+            repetidas().guarda(data, width, height, saida.linha.substr(name.length() + 1),
+                               permanente);
+        }
+    } catch (...) {
+        saida.erro = std::current_exception();
+    }
+    return saida;
+}
+
+resultado conta_texto(std::string_view name, std::string_view data, int width, int height,
+                      const opcoes& opcoes) {
+    resultado saida;
+    try {
+        /// só a contagem, em corridas: o trabalho cresce com o número de corridas
+        area::rascunho& memoria = area::rascunho_local();
+        /// as corridas e o fluxo não guardam os rótulos de cada pixel
+        const bool so_contagem = not opcoes.estatisticas && opcoes.dir_rotulos.empty()
+            && opcoes.conectividade == 4;
+        if (opcoes.rle && so_contagem) {
+            area::matriz_nova(data, width, height, memoria.rle, memoria.linha);
+            MEDE_FASE(medicao::rotulacao);
+            MEDE_PIXELS(medicao::rotulacao, static_cast<std::int64_t>(width) * height);
+            int regions = area::area_rle(memoria.rle, memoria.conjuntos);
+            saida.linha.append(name).append(1, ' ').append(std::to_string(regions));
+            return saida;
+        }
+        /// só a contagem: rotula linha por linha, sem montar a matriz
+        if (opcoes.fluxo && so_contagem) {
+            MEDE_FASE(medicao::rotulacao);
+            MEDE_BYTES(medicao::rotulacao, data.length());
+            MEDE_PIXELS(medicao::rotulacao, static_cast<std::int64_t>(width) * height);
+            int regions = area::area_fluxo(data, width, height, memoria);
+            saida.linha.append(name).append(1, ' ').append(std::to_string(regions));
+            return saida;
+        }
+        /// a matriz fica no rascunho da thread, com a memória das imagens anteriores
+        area::matriz_nova(data, width, height, memoria.matriz);
+        return conta(name, memoria.matriz, opcoes);
+    } catch (...) {
+        saida.erro = std::current_exception();
+    }
+    return saida;
+}
+
+resultado conta(std::string_view name, const area::bitmap& matrix, const opcoes& opcoes) {
+    MEDE_FASE(medicao::rotulacao);
+    MEDE_PIXELS(medicao::rotulacao, static_cast<std::int64_t>(matrix.largura()) * matrix.altura());
+    resultado saida;
+    try {
+        area::rascunho& memoria = area::rascunho_local();
+        /// o mapa de rótulos sai da mesma rotulação que conta as áreas
+        std::vector<std::uint32_t>* mapa = opcoes.dir_rotulos.empty() ? nullptr
+                                                                       : &memoria.rotulos;
+        if (not opcoes.estatisticas && opcoes.conectividade == 4) {
+            int regions = area::area_contador(matrix, opcoes.modo, opcoes.faixas, memoria,
+                                              mapa);
+            if (mapa != nullptr && not grava_rotulos(name, matrix.largura(), matrix.altura(),
+                                                     regions, *mapa, opcoes)) {
+                saida.gravou = false;
+                return saida;
+            }
+            saida.linha.append(name).append(1, ' ').append(std::to_string(regions));
+            return saida;
+        }
+
+        int regions = opcoes.conectividade == 8
+            ? area::area_estatisticas<8>(matrix, memoria, mapa)
+            : area::area_estatisticas<4>(matrix, memoria, mapa);
+        const std::vector<area::componente>& componentes = memoria.componentes;
+        if (mapa != nullptr && not grava_rotulos(name, matrix.largura(), matrix.altura(),
+                                                 regions, *mapa, opcoes)) {
+            saida.gravou = false;
+            return saida;
+        }
+        /// reserva de uma vez o texto de todas as áreas, em vez de crescer aos poucos
+        if (opcoes.estatisticas) {
+            saida.linha.reserve(name.length() + 12u + componentes.size() * 48u);
+        }
+        saida.linha.append(name).append(1, ' ').append(std::to_string(regions));
+        /// uma linha por área: pixels, caixa envolvente (topo esquerda base direita) e centróide
+        for (std::size_t k = 0u; opcoes.estatisticas && k < componentes.size(); k++) {
+            const area::componente& c = componentes[k];
+            char texto[160];
+            std::snprintf(texto, sizeof(texto), "\n  %zu %lld %d %d %d %d %.2f %.2f",
+                          k + 1, static_cast<long long>(c.area), c.topo, c.esquerda,
+                          c.base, c.direita, c.centro_i(), c.centro_j());
+            saida.linha.append(texto);
+        }
+    } catch (...) {
+        saida.erro = std::current_exception();
+    }
+    return saida;
+}
+
+bool grava_rotulos(std::string_view name, int width, int height, int regions,
+                   const std::vector<std::uint32_t>& rotulos, const opcoes& opcoes) {
+    /// o PGM guarda até 16 bits por pixel
+    if (opcoes.formato == formato_rotulos::pgm && regions > 65535) {
+        return false;
+    }
+    /// a barra não pode fazer parte do nome do arquivo
+    std::string caminho = opcoes.dir_rotulos;
+    caminho.append(1, '/');
+    const std::size_t inicio_nome = caminho.length();
+    caminho.append(name);
+    std::replace(caminho.begin() + inicio_nome, caminho.end(), '/', '_');
+    caminho.append(opcoes.formato == formato_rotulos::pgm ? ".pgm" : ".u32");
+
+    std::ofstream arquivo(caminho, std::ios::binary);
+    if (opcoes.formato == formato_rotulos::binario) {
+        arquivo.write(reinterpret_cast<const char*>(rotulos.data()),
+                      rotulos.size() * sizeof(std::uint32_t));
+    } else {
+        /// com mais de 255 áreas, 2 bytes por pixel, em big-endian
+        const int maximo = std::max(regions, 1);
+        arquivo << "P5\n" << width << ' ' << height << '\n' << maximo << '\n';
+        std::string pixels;
+        if (maximo < 256) {
+            pixels.assign(rotulos.begin(), rotulos.end());
+        } else {
+            pixels.resize(rotulos.size() * 2u);
+            for (std::size_t k = 0u; k < rotulos.size(); k++) {
+                pixels[2u * k] = static_cast<char>(rotulos[k] >> 8);
+                pixels[2u * k + 1u] = static_cast<char>(rotulos[k] & 0xffu);
+            }
+        }
+        arquivo.write(pixels.data(), pixels.size());
+    }
+    return static_cast<bool>(arquivo);
+}
+
+deduplicacao::deduplicacao(std::size_t limite_bytes) : limite_bytes_{limite_bytes} {}
+
+bool deduplicacao::busca(std::string_view data, int width, int height, std::string& texto) {
+    const std::uint64_t chave = dispersao(data, width, height);
+    std::lock_guard<std::mutex> trava(mutex_);
+    auto [inicio, fim] = entradas_.equal_range(chave);
+    for (auto it = inicio; it != fim; ++it) {
+        const entrada& e = it->second;
+        /// a dispersão só aponta candidatos: confirma que o conteúdo é o mesmo
+        if (e.width == width && e.height == height && e.data == data) {
+            texto = e.texto;
+            return true;
+        }
+    }
+    return false;
+}
+
+void deduplicacao::guarda(std::string_view data, int width, int height, std::string texto,
+                          bool permanente) {
+    const std::uint64_t chave = dispersao(data, width, height);
+    std::lock_guard<std::mutex> trava(mutex_);
+    auto [inicio, fim] = entradas_.equal_range(chave);
+    for (auto it = inicio; it != fim; ++it) {
+        /// outra thread já guardou o mesmo conteúdo
+        if (it->second.width == width && it->second.height == height && it->second.data == data) {
+            return;
+        }
+    }
+    /// a cópia fica na deque, que não move os elementos ao crescer nas pontas
+    guardada& nova = ordem_.emplace_back();
+    nova.chave = chave;
+    nova.bytes = texto.length();
+    if (not permanente) {
+        nova.copia.assign(data);
+        data = nova.copia;
+        nova.bytes += data.length();
+    }
+    nova.data = data.data();
+    bytes_ += nova.bytes;
+    entradas_.emplace(chave, entrada{data, width, height, std::move(texto)});
+    while (bytes_ > limite_bytes_ && not ordem_.empty()) {
+        descarta_mais_antiga();
+    }
+}
+
+void deduplicacao::descarta_mais_antiga() {
+    const guardada& antiga = ordem_.front();
+    auto [inicio, fim] = entradas_.equal_range(antiga.chave);
+    for (auto it = inicio; it != fim; ++it) {
+        /// com a mesma dispersão pode haver outras; a entrada é a que aponta para o
+        /// mesmo conteúdo
+        if (it->second.data.data() == antiga.data) {
+            entradas_.erase(it);
+            break;
+        }
+    }
+    bytes_ -= antiga.bytes;
+    ordem_.pop_front();
+}
+
+std::uint64_t deduplicacao::dispersao(std::string_view data, int width, int height) {
+    const std::uint64_t primo = 0x9E3779B97F4A7C15ull;
+    std::uint64_t h = (static_cast<std::uint64_t>(width) << 32 | static_cast<std::uint32_t>(height))
+        * primo ^ data.length();
+    const char* p = data.data();
+    std::size_t n = data.length();
+    for (; n >= 8u; p += 8, n -= 8u) {
+        std::uint64_t k;
+        std::memcpy(&k, p, sizeof(k));
+        h = (h ^ (k * primo)) * 0xC2B2AE3D27D4EB4Full;
+        h ^= h >> 29;
+    }
+    /// sem <data>, a fatia é vazia e p é nulo: não há resto para misturar
+    if (n != 0u) {
+        std::uint64_t k = 0u;
+        std::memcpy(&k, p, n);
+        h = (h ^ (k * primo)) * 0xC2B2AE3D27D4EB4Full;
+    }
+    /// mistura final, como a do MurmurHash3
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    return h;
+}
+
+deduplicacao& repetidas() {
+    static deduplicacao tabela;
+    return tabela;
+}
+
+int executa(std::size_t total, std::function<resultado(std::size_t)> tarefa,
+            const opcoes& opcoes) {
+    saida::escritor& saida = saida::padrao();
+
+    if (opcoes.threads <= 1) {
+        for (std::size_t k = 0u; k < total; k++) {
+            resultado r = tarefa(k);
+            if (r.erro) {
+                saida.descarrega();
+                std::rethrow_exception(r.erro);
+            }
+             /// se for uma imagem inválida, com altura e largura menores ou iguais a 0, retorna -1
+            if (not r.valido) {
+                return -1;
+            }
+            /// sem o mapa de rótulos pedido, a execução termina com erro
+            if (not r.gravou) {
+                saida.escreve("error");
+                return -1;
+            }
+            saida.linha(r.linha);
+        }
+        return 0;
+    }
+
+    /// as imagens são independentes: cada thread processa uma por vez, e o
+    /// escritor coloca os resultados na ordem em que aparecem no arquivo
+    std::vector<std::exception_ptr> erros(total);
+    std::vector<char> sem_rotulos(total, 0);
+    saida.inicia_lote(total);
+    paralelo::pool threads(opcoes.threads);
+    for (std::size_t k = 0u; k < total; k++) {
+        threads.submete([&saida, &erros, &sem_rotulos, &tarefa, k]() {
+            resultado r = tarefa(k);
+            erros[k] = r.erro;
+            sem_rotulos[k] = not r.gravou;
+            saida.entrega(k, std::move(r.linha), r.erro || not r.valido || not r.gravou);
+        });
+    }
+    const std::size_t escritos = saida.espera();
+    if (escritos < total) {
+        threads.cancela();
+        if (erros[escritos]) {
+            saida.descarrega();
+            std::rethrow_exception(erros[escritos]);
+        }
+        if (sem_rotulos[escritos]) {
+            saida.escreve("error");
+        }
+        return -1;
+    }
+    return 0;
+}
+
+int converte(const char* contents, const std::vector<xml::registro>& imagens,
+             const std::string& destino) {
+    cache::gravador gravador;
+    if (not gravador.abre(destino)) {
+        saida::padrao().escreve("error");
+        return -1;
+    }
+    for (const xml::registro& r : imagens) {
+        const std::string_view name = r.name.em(contents);
+        const int width = xml::para_int(r.width.em(contents));
+        const int height = xml::para_int(r.height.em(contents));
+        if (height <= 0|| width <= 0) {
+            std::remove(destino.c_str());
+            return -1;
+        }
+        std::string_view data = r.data.em(contents);
+        gravador.adiciona(name, area::matriz_nova(data, width, height));
+    }
+    if (not gravador.fecha()) {
+        saida::padrao().escreve("error");
+        return -1;
+    }
+    return 0;
+}
+
+int processa_incremental(const opcoes& opcoes) {
+    bool imagem_invalida = false;
+    bool sem_rotulos = false;
+    xml::leitor_incremental leitor([&](std::string_view image) {
+        resultado r = processa(image, opcoes);
+        if (r.erro) {
+            saida::padrao().descarrega();
+            std::rethrow_exception(r.erro);
+        }
+        if (not r.valido) {
+            imagem_invalida = true;
+            return false;
+        }
+        if (not r.gravou) {
+            sem_rotulos = true;
+            return false;
+        }
+        saida::padrao().linha(r.linha);
+        return true;
+    });
+
+    const std::size_t tamanho_bloco = 64u * 1024u;
+    std::vector<char> bloco(tamanho_bloco);
+    while (true) {
+        const ssize_t lidos = ::read(STDIN_FILENO, bloco.data(), bloco.size());
+        if (lidos < 0 && errno == EINTR) {
+            continue;
+        }
+        if (lidos <= 0) {
+            break;
+        }
+        const xml::leitor_incremental::estado e = leitor.alimenta(bloco.data(), lidos);
+        /// os resultados do bloco saem juntos, antes de esperar pelo próximo
+        saida::padrao().descarrega();
+        if (e == xml::leitor_incremental::interrompido) {
+            if (sem_rotulos) {
+                saida::padrao().escreve("error");
+            }
+            return -1;
+        }
+        if (e == xml::leitor_incremental::invalido) {
+            saida::padrao().escreve("error");
+            return -1;
+        }
+    }
+    if (imagem_invalida) {
+        return -1;
+    }
+    /// os resultados anteriores já saíram; o erro só aparece quando o xml termina mal
+    if (not leitor.termina()) {
+        saida::padrao().escreve("error");
+        return -1;
+    }
+    return 0;
+}
+
+int processa_lote(const opcoes& opcoes) {
+    saida::escritor& saida = saida::padrao();
+
+    /// um arquivo do lote: fica aberto até a última imagem dele ser processada
+    struct item {
+        const std::string* nome;
+        xml::arquivo arquivo;
+        std::vector<xml::registro> imagens;
+        std::vector<cache::imagem> binarias;
+        std::atomic<std::size_t> restantes{0u};
+    };
+    std::deque<item> itens;
+    std::atomic<bool> falhou{false};
+
+    /// no máximo um arquivo aberto por thread, mais o que está sendo varrido: sem isso a
+    /// thread principal abriria e mapearia todos os arquivos antes das contagens
+    const std::size_t limite_abertos = static_cast<std::size_t>(opcoes.threads) + 1u;
+    std::size_t abertos = 0u;
+    std::mutex mutex_abertos;
+    std::condition_variable fechou;
+    /// fecha o arquivo e solta as posições das imagens, liberando a vaga dele
+    auto fecha = [&abertos, &mutex_abertos, &fechou](item& atual) {
+        atual.arquivo.fecha();
+        std::vector<xml::registro>().swap(atual.imagens);
+        std::vector<cache::imagem>().swap(atual.binarias);
+        std::lock_guard<std::mutex> trava(mutex_abertos);
+        abertos--;
+        fechou.notify_one();
+    };
+
+    /// a thread principal abre e varre o próximo arquivo enquanto as threads do pool
+    /// ainda contam as imagens dos anteriores; o escritor junta tudo na ordem dos arquivos
+    saida.inicia_lote(0u);
+    paralelo::pool threads(opcoes.threads);
+    std::size_t indice = 0u;
+    for (const std::string& nome : opcoes.arquivos) {
+        {
+            std::unique_lock<std::mutex> trava(mutex_abertos);
+            fechou.wait(trava, [&abertos, limite_abertos]() {
+                return abertos < limite_abertos;
+            });
+            abertos++;
+        }
+        item& atual = itens.emplace_back();
+        atual.nome = &nome;
+        bool ok = atual.arquivo.abre(nome);
+        const bool binario = ok && cache::reconhece(atual.arquivo.dados(),
+                                                    atual.arquivo.tamanho());
+        if (binario) {
+            ok = cache::le(atual.arquivo.dados(), atual.arquivo.tamanho(), atual.binarias);
+        } else if (ok) {
+            ok = xml::varre(atual.arquivo.dados(), atual.arquivo.tamanho(), atual.imagens);
+        }
+        const std::size_t total = binario ? atual.binarias.size() : atual.imagens.size();
+        if (not ok || total == 0u) {
+            fecha(atual);
+            if (not ok) {
+                falhou = true;
+                saida.amplia_lote(1u);
+                saida.entrega(indice++, nome + " error", false);
+            }
+            continue;
+        }
+
+        atual.restantes = total;
+        saida.amplia_lote(total);
+        for (std::size_t k = 0u; k < total; k++) {
+            threads.submete([&saida, &falhou, &atual, &opcoes, &fecha, binario, k,
+                             i = indice++]() {
+                resultado r;
+                if (binario) {
+                    r = conta(atual.binarias[k].nome, atual.binarias[k].pixels, opcoes);
+                } else {
+                    /// o arquivo é fechado ao terminar suas imagens
+                    r = processa(atual.arquivo.dados(), atual.imagens[k], opcoes, false);
+                }
+                /// uma imagem inválida ou com erro vira uma linha de erro e o lote segue
+                std::string texto = *atual.nome;
+                if (r.erro || not r.valido || not r.gravou) {
+                    falhou = true;
+                    texto.append(" error");
+                } else {
+                    texto.append(1, ' ').append(r.linha);
+                }
+                saida.entrega(i, std::move(texto), false);
+                if (--atual.restantes == 0u) {
+                    fecha(atual);
+                }
+            });
+        }
+    }
+    saida.espera();
+    return falhou ? -1 : 0;
+}
+
+int processa_pipeline(const std::string& nome, const opcoes& opcoes) {
+    saida::escritor& saida = saida::padrao();
+    const int fd = ::open(nome.c_str(), O_RDONLY);
+    if (fd < 0) {
+        saida.escreve("error");
+        return -1;
+    }
+
+    /// uma imagem separada do xml, com a cópia do seu conteúdo e a sua posição na saída
+    struct peca {
+        std::size_t indice{0u};
+        std::string texto;
+    };
+    /// no máximo 8 blocos de 256 KiB lidos e ainda não separados, e duas imagens por
+    /// thread esperando a contagem
+    const std::size_t tamanho_bloco = 256u * 1024u;
+    paralelo::fila_limitada<std::string> blocos(8u);
+    paralelo::fila_limitada<peca> pecas(2u * opcoes.threads);
+
+    /// a saída para no menor índice com erro ou imagem inválida; as imagens depois
+    /// dele nem são contadas
+    std::atomic<std::size_t> parada{std::numeric_limits<std::size_t>::max()};
+    /// a primeira imagem com exceção ou sem mapa de rótulos (aí erro fica nulo)
+    std::mutex mutex_erro;
+    std::exception_ptr erro;
+    std::size_t indice_erro = std::numeric_limits<std::size_t>::max();
+
+    /// etapa 1: lê o arquivo em blocos, até o fim ou até a fila ser fechada
+    std::thread leitura([fd, tamanho_bloco, &blocos]() {
+        while (true) {
+            std::string bloco(tamanho_bloco, '\0');
+            ssize_t lidos;
+            {
+                MEDE_FASE(medicao::leitura);
+                lidos = ::read(fd, &bloco[0], bloco.size());
+            }
+            if (lidos < 0 && errno == EINTR) {
+                continue;
+            }
+            if (lidos <= 0) {
+                break;
+            }
+            MEDE_BYTES(medicao::leitura, lidos);
+            bloco.resize(lidos);
+            if (not blocos.coloca(std::move(bloco))) {
+                break;
+            }
+        }
+        blocos.fecha();
+    });
+
+    /// etapa 3: as threads do pool contam as áreas de cada imagem separada
+    saida.inicia_lote(0u);
+    paralelo::pool threads(opcoes.threads);
+    for (int t = 0; t < opcoes.threads; t++) {
+        threads.submete([&]() {
+            peca p;
+            while (pecas.retira(p)) {
+                if (p.indice > parada.load()) {
+                    continue;
+                }
+                resultado r = processa(p.texto, opcoes);
+                const bool para = r.erro || not r.valido || not r.gravou;
+                if (para) {
+                    std::size_t atual = parada.load();
+                    while (p.indice < atual && not parada.compare_exchange_weak(atual, p.indice)) {
+                    }
+                    /// sem exceção, o erro guardado é o do mapa de rótulos
+                    if (r.erro || not r.gravou) {
+                        std::lock_guard<std::mutex> trava(mutex_erro);
+                        if (p.indice < indice_erro) {
+                            indice_erro = p.indice;
+                            erro = r.erro;
+                        }
+                    }
+                }
+                saida.entrega(p.indice, std::move(r.linha), para);
+            }
+        });
+    }
+
+    /// etapa 2, nesta thread: separa as imagens dos blocos, validando o aninhamento
+    std::size_t indice = 0u;
+    xml::leitor_incremental leitor([&](std::string_view image) {
+        if (indice > parada.load()) {
+            return false;
+        }
+        saida.amplia_lote(1u);
+        return pecas.coloca(peca{indice++, std::string(image)});
+    });
+    xml::leitor_incremental::estado e = xml::leitor_incremental::continua;
+    std::string bloco;
+    while (e == xml::leitor_incremental::continua && blocos.retira(bloco)) {
+        e = leitor.alimenta(bloco.data(), bloco.size());
+    }
+    /// se a separação parou antes do fim, a leitura também para
+    blocos.fecha();
+    leitura.join();
+    ::close(fd);
+    pecas.fecha();
+
+    const std::size_t escritos = saida.espera();
+    {
+        std::lock_guard<std::mutex> trava(mutex_erro);
+        if (escritos == indice_erro && erro) {
+            saida.descarrega();
+            std::rethrow_exception(erro);
+        }
+        if (escritos == indice_erro) {
+            saida.escreve("error");
+            return -1;
+        }
+    }
+    if (escritos < indice || e == xml::leitor_incremental::interrompido) {
+        return -1;
+    }
+    /// como no modo incremental, os resultados anteriores já saíram
+    if (e == xml::leitor_incremental::invalido || not leitor.termina()) {
+        saida.escreve("error");
+        return -1;
+    }
+    return 0;
+}
+}   /// namespace programa
+
+namespace medicao {
+#ifdef PROJETO_ESTATISTICAS
+namespace {
+const char* const NOMES[total_fases] = {
+    "leitura", "validacao", "extracao", "matriz", "rotulacao", "outras"};
+contadores tabela[total_fases];
+/// fase da thread e o instante em que ela entrou nessa fase (ou voltou para ela)
+thread_local fase fase_atual = outras;
+thread_local std::chrono::steady_clock::time_point desde = std::chrono::steady_clock::now();
+
+/// fecha o tempo da fase atual até agora
+void acumula_tempo() {
+    const auto agora = std::chrono::steady_clock::now();
+    tabela[fase_atual].nanossegundos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        agora - desde).count();
+    desde = agora;
+}
+}   /// namespace
+
+contadores& de(fase f) {
+    return tabela[f];
+}
+
+fase atual() {
+    return fase_atual;
+}
+
+escopo::escopo(fase f) :
+    anterior_{fase_atual}
+{
+    acumula_tempo();
+    fase_atual = f;
+}
+
+escopo::~escopo() {
+    acumula_tempo();
+    fase_atual = anterior_;
+}
+#endif
+
+relatorio::relatorio(formato f) :
+    formato_{f}
+{}
+
+relatorio::~relatorio() {
+    if (formato_ == formato::nenhum) {
+        return;
+    }
+#ifdef PROJETO_ESTATISTICAS
+    acumula_tempo();
+    const bool json = formato_ == formato::json;
+    std::fprintf(stderr, json ? "{" : "%-10s %12s %14s %10s %12s %14s %12s\n",
+                 "fase", "tempo_ms", "bytes", "MB/s", "alocacoes", "pixels", "Mpixels/s");
+    for (int f = 0; f < total_fases; f++) {
+        const double ms = tabela[f].nanossegundos / 1e6;
+        const long long bytes = tabela[f].bytes;
+        const long long alocacoes = tabela[f].alocacoes;
+        const long long pixels = tabela[f].pixels;
+        const double mb_s = ms > 0 ? bytes / (1024.0 * 1024.0) / (ms / 1e3) : 0.0;
+        const double mpx_s = ms > 0 ? pixels / 1e6 / (ms / 1e3) : 0.0;
+        if (json) {
+            std::fprintf(stderr, "%s\"%s\":{\"tempo_ms\":%.3f,\"bytes\":%lld,"
+                         "\"alocacoes\":%lld,\"pixels\":%lld}",
+                         f > 0 ? "," : "", NOMES[f], ms, bytes, alocacoes, pixels);
+        } else {
+            std::fprintf(stderr, "%-10s %12.3f %14lld %10.1f %12lld %14lld %12.1f\n",
+                         NOMES[f], ms, bytes, mb_s, alocacoes, pixels, mpx_s);
+        }
+    }
+    if (json) {
+        std::fprintf(stderr, "}\n");
+    }
+#else
+    std::fprintf(stderr,
+                 "--stats: instrumentação desativada; compile com -DPROJETO_ESTATISTICAS\n");
+#endif
+}
+}   /// namespace medicao
+
+#ifdef PROJETO_ESTATISTICAS
+/// toda alocação conta para a fase em que a thread está
+void* operator new(std::size_t tamanho) {
+    medicao::de(medicao::atual()).alocacoes.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(tamanho ? tamanho : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+/// o gcc não percebe que o operator new acima também usa malloc
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+#pragma GCC diagnostic pop
+#endif
+
+namespace cache {
+namespace {
+/// cabeçalho de cada imagem no arquivo
+struct cabecalho_imagem {
+    std::uint32_t tamanho_nome;
+    std::uint32_t largura;
+    std::uint32_t altura;
+    std::uint32_t reservado;
+};
+
+/// arredonda para o próximo múltiplo de 8
+std::size_t alinha(std::size_t n) {
+    return (n + 7u) & ~std::size_t{7u};
+}
+
+const std::size_t TAMANHO_CABECALHO = 16u;
+}   /// namespace
+
+bool reconhece(const char* dados, std::size_t tamanho) {
+    return tamanho >= TAMANHO_CABECALHO && std::memcmp(dados, MAGICA, sizeof(MAGICA)) == 0;
+}
+
+bool le(const char* dados, std::size_t tamanho, std::vector<imagem>& imagens) {
+    MEDE_FASE(medicao::validacao);
+    MEDE_BYTES(medicao::validacao, tamanho);
+    std::uint32_t versao;
+    std::uint64_t quantidade;
+    std::memcpy(&versao, dados + 4, sizeof(versao));
+    std::memcpy(&quantidade, dados + 8, sizeof(quantidade));
+    if (versao != VERSAO) {
+        return false;
+    }
+    /// as palavras só podem ser lidas no lugar se o mapeamento estiver alinhado
+    if (reinterpret_cast<std::uintptr_t>(dados) % alignof(std::uint64_t) != 0u) {
+        return false;
+    }
+
+    std::size_t pos = TAMANHO_CABECALHO;
+    for (std::uint64_t k = 0u; k < quantidade; k++) {
+        cabecalho_imagem c;
+        if (tamanho - pos < sizeof(c)) {
+            return false;
+        }
+        std::memcpy(&c, dados + pos, sizeof(c));
+        pos += sizeof(c);
+        const std::size_t passo = (static_cast<std::size_t>(c.largura) + 63u) / 64u;
+        const std::size_t bytes = passo * c.altura * sizeof(std::uint64_t);
+        if (c.largura == 0u || c.altura == 0u || c.largura > INT32_MAX || c.altura > INT32_MAX
+            || tamanho - pos < alinha(c.tamanho_nome)
+            || tamanho - pos - alinha(c.tamanho_nome) < bytes) {
+            return false;
+        }
+        std::string_view nome(dados + pos, c.tamanho_nome);
+        pos += alinha(c.tamanho_nome);
+        const std::uint64_t* palavras = reinterpret_cast<const std::uint64_t*>(dados + pos);
+        pos += bytes;
+        /// os bits depois de largura na última palavra de cada linha têm de ser zero: os
+        /// algoritmos que andam por palavras os contariam como pixels; como a vista aponta
+        /// para o arquivo, não dá para apagá-los, então o arquivo é recusado
+        if (c.largura % 64u != 0u) {
+            const std::uint64_t sobra = ~std::uint64_t{0} << (c.largura % 64u);
+            for (std::size_t i = 0u; i < c.altura; i++) {
+                if ((palavras[i * passo + passo - 1u] & sobra) != 0u) {
+                    return false;
+                }
+            }
+        }
+        imagens.push_back({nome, area::bitmap::vista(palavras, c.largura, c.altura)});
+    }
+    return true;
+}
+
+bool gravador::abre(const std::string& nome) {
+    arquivo_.open(nome, std::ios::binary | std::ios::trunc);
+    if (not arquivo_.is_open()) {
+        return false;
+    }
+    /// a quantidade de imagens é preenchida no fecha
+    const char zeros[TAMANHO_CABECALHO] = {};
+    arquivo_.write(zeros, sizeof(zeros));
+    return static_cast<bool>(arquivo_);
+}
+
+void gravador::adiciona(std::string_view nome, const area::bitmap& pixels) {
+    const cabecalho_imagem c{static_cast<std::uint32_t>(nome.length()),
+                             static_cast<std::uint32_t>(pixels.largura()),
+                             static_cast<std::uint32_t>(pixels.altura()), 0u};
+    arquivo_.write(reinterpret_cast<const char*>(&c), sizeof(c));
+    arquivo_.write(nome.data(), nome.length());
+    const char zeros[8] = {};
+    arquivo_.write(zeros, alinha(nome.length()) - nome.length());
+    for (int i = 0; i < pixels.altura(); i++) {
+        arquivo_.write(reinterpret_cast<const char*>(pixels.linha(i)),
+                       pixels.passo() * sizeof(std::uint64_t));
+    }
+    quantidade_++;
+}
+
+bool gravador::fecha() {
+    arquivo_.seekp(0);
+    arquivo_.write(MAGICA, sizeof(MAGICA));
+    arquivo_.write(reinterpret_cast<const char*>(&VERSAO), sizeof(VERSAO));
+    arquivo_.write(reinterpret_cast<const char*>(&quantidade_), sizeof(quantidade_));
+    arquivo_.close();
+    return not arquivo_.fail();
+}
+}   /// namespace cache
+
+namespace paralelo {
+pool::pool(int threads) {
+    for (int i = 0; i < threads; i++) {
+        threads_.emplace_back(&pool::trabalha, this);
+    }
+}
+
+pool::~pool() {
+    {
+        std::lock_guard<std::mutex> trava(mutex_);
+        fim_ = true;
+    }
+    aviso_.notify_all();
+    for (std::thread& t : threads_) {
+        t.join();
+    }
+}
+
+void pool::submete(std::function<void()> tarefa) {
+    {
+        std::lock_guard<std::mutex> trava(mutex_);
+        tarefas_.push_back(std::move(tarefa));
+    }
+    aviso_.notify_one();
+}
+
+int pool::tamanho() const {
+    return static_cast<int>(threads_.size());
+}
+
+void pool::cancela() {
+    std::lock_guard<std::mutex> trava(mutex_);
+    tarefas_.clear();
+}
+
+template<typename T>
+fila_limitada<T>::fila_limitada(std::size_t capacidade) : fila_(capacidade) {}
+
+template<typename T>
+bool fila_limitada<T>::coloca(T dado) {
+    {
+        std::unique_lock<std::mutex> trava(mutex_);
+        nao_cheia_.wait(trava, [this]() { return fechada_ || not fila_.full(); });
+        if (fechada_) {
+            return false;
+        }
+        fila_.enqueue(std::move(dado));
+    }
+    nao_vazia_.notify_one();
+    return true;
+}
+
+template<typename T>
+bool fila_limitada<T>::retira(T& dado) {
+    {
+        std::unique_lock<std::mutex> trava(mutex_);
+        nao_vazia_.wait(trava, [this]() { return fechada_ || not fila_.empty(); });
+        /// depois de fechada, ainda entrega o que já estava na fila
+        if (fila_.empty()) {
+            return false;
+        }
+        dado = fila_.dequeue();
+    }
+    nao_cheia_.notify_one();
+    return true;
+}
+
+template<typename T>
+void fila_limitada<T>::fecha() {
+    {
+        std::lock_guard<std::mutex> trava(mutex_);
+        fechada_ = true;
+    }
+    nao_cheia_.notify_all();
+    nao_vazia_.notify_all();
+}
+
+pool& ajudantes_faixas(int faixas) {
+    /// hardware_concurrency pode devolver 0 quando não sabe
+    const int nucleos = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    static pool ajudantes(std::max(0, std::min(faixas, nucleos) - 1));
+    return ajudantes;
+}
+
+void pool::trabalha() {
+    while (true) {
+        std::function<void()> tarefa;
+        {
+            std::unique_lock<std::mutex> trava(mutex_);
+            aviso_.wait(trava, [this]() { return fim_ || !tarefas_.empty(); });
+            /// só termina depois de esvaziar a fila
+            if (tarefas_.empty()) {
+                return;
+            }
+            tarefa = std::move(tarefas_.front());
+            tarefas_.pop_front();
+        }
+        tarefa();
+    }
+}
+
+}   /// namespace paralelo
+
+namespace saida {
+escritor::escritor(int fd, std::size_t capacidade) :
+    fd_{fd},
+    capacidade_{capacidade}
+{
+    buffer_.reserve(capacidade_);
+}
+
+escritor::~escritor() {
+    descarrega();
+}
+
+void escritor::escreve(std::string_view texto) {
+    std::lock_guard<std::mutex> trava(mutex_);
+    acrescenta(texto);
+}
+
+void escritor::linha(std::string_view texto) {
+    std::lock_guard<std::mutex> trava(mutex_);
+    acrescenta(texto);
+    acrescenta("\n");
+}
+
+void escritor::acrescenta(std::string_view texto) {
+    /// só grava quando o buffer passaria da capacidade
+    if (buffer_.length() + texto.length() > capacidade_) {
+        grava();
+    }
+    buffer_.append(texto);
+}
+
+void escritor::descarrega() {
+    std::lock_guard<std::mutex> trava(mutex_);
+    grava();
+}
+
+void escritor::grava() {
+    std::size_t gravado = 0u;
+    while (gravado < buffer_.length()) {
+        const ssize_t n = ::write(fd_, buffer_.data() + gravado, buffer_.length() - gravado);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        gravado += n;
+    }
+    buffer_.clear();
+}
+
+void escritor::inicia_lote(std::size_t total) {
+    std::lock_guard<std::mutex> trava(mutex_);
+    pendentes_.assign(total, std::nullopt);
+    proximo_ = 0u;
+    parada_ = total;
+}
+
+void escritor::entrega(std::size_t indice, std::string texto, bool para) {
+    std::lock_guard<std::mutex> trava(mutex_);
+    if (para) {
+        parada_ = std::min(parada_, indice);
+    }
+    pendentes_[indice] = std::move(texto);
+    /// escreve todas as linhas seguidas que já chegaram, a partir da próxima da vez
+    while (proximo_ < parada_ && pendentes_[proximo_].has_value()) {
+        acrescenta(*pendentes_[proximo_]);
+        acrescenta("\n");
+        pendentes_[proximo_].reset();
+        proximo_++;
+    }
+    if (proximo_ == parada_) {
+        aviso_.notify_all();
+    }
+}
+
+void escritor::amplia_lote(std::size_t mais) {
+    std::lock_guard<std::mutex> trava(mutex_);
+    const bool parou = parada_ < pendentes_.size();
+    pendentes_.resize(pendentes_.size() + mais);
+    if (not parou) {
+        parada_ = pendentes_.size();
+    }
+}
+
+std::size_t escritor::espera() {
+    std::unique_lock<std::mutex> trava(mutex_);
+    aviso_.wait(trava, [this]() { return proximo_ == parada_; });
+    return proximo_;
+}
+
+escritor& padrao() {
+    static escritor saida(STDOUT_FILENO);
+    return saida;
+}
+}   /// namespace saida
+
+namespace area {
+bitmap::bitmap(int largura, int altura) :
+    largura_{largura},
+    altura_{altura},
+    passo_{(static_cast<std::size_t>(largura) + 63u) / 64u},
+    memoria_(passo_ * altura, 0u)
+{
+    palavras_ = memoria_.data();
+}
+
+bitmap::bitmap(const bitmap& outro) :
+    largura_{outro.largura_},
+    altura_{outro.altura_},
+    passo_{outro.passo_},
+    memoria_(outro.palavras_, outro.palavras_ + outro.passo_ * outro.altura_)
+{
+    palavras_ = memoria_.data();
+}
+
+bitmap::bitmap(bitmap&& outro) noexcept :
+    largura_{outro.largura_},
+    altura_{outro.altura_},
+    passo_{outro.passo_},
+    palavras_{outro.palavras_},
+    memoria_(std::move(outro.memoria_))
+{
+    outro.palavras_ = nullptr;
+    outro.largura_ = outro.altura_ = 0;
+    outro.passo_ = 0u;
+}
+
+bitmap& bitmap::operator=(bitmap outro) noexcept {
+    std::swap(largura_, outro.largura_);
+    std::swap(altura_, outro.altura_);
+    std::swap(passo_, outro.passo_);
+    std::swap(palavras_, outro.palavras_);
+    memoria_.swap(outro.memoria_);
+    return *this;
+}
+
+void bitmap::redimensiona(int largura, int altura) {
+    largura_ = largura;
+    altura_ = altura;
+    passo_ = (static_cast<std::size_t>(largura) + 63u) / 64u;
+    /// assign não realoca enquanto couber na capacidade atual
+    memoria_.assign(passo_ * altura, 0u);
+    palavras_ = memoria_.data();
+}
+
+void bitmap::copia(const bitmap& outro) {
+    if (&outro == this) {
+        return;
+    }
+    largura_ = outro.largura_;
+    altura_ = outro.altura_;
+    passo_ = outro.passo_;
+    memoria_.assign(outro.palavras_, outro.palavras_ + outro.passo_ * outro.altura_);
+    palavras_ = memoria_.data();
+}
+
+bitmap bitmap::vista(const std::uint64_t* palavras, int largura, int altura) {
+    bitmap matrix;
+    matrix.largura_ = largura;
+    matrix.altura_ = altura;
+    matrix.passo_ = (static_cast<std::size_t>(largura) + 63u) / 64u;
+    /// a vista só é lida, então tirar o const não chega a escrever nas palavras
+    matrix.palavras_ = const_cast<std::uint64_t*>(palavras);
+    return matrix;
+}
+
+int bitmap::largura() const {
+    return largura_;
+}
+
+int bitmap::altura() const {
+    return altura_;
+}
+
+std::size_t bitmap::passo() const {
+    return passo_;
+}
+
+bool bitmap::pixel(int i, int j) const {
+    return (linha(i)[j >> 6] >> (j & 63)) & 1u;
+}
+
+void bitmap::liga(int i, int j) {
+    linha(i)[j >> 6] |= std::uint64_t{1} << (j & 63);
+}
+
+void bitmap::apaga(int i, int j) {
+    linha(i)[j >> 6] &= ~(std::uint64_t{1} << (j & 63));
+}
+
+void bitmap::apaga(int i, int inicio, int fim) {
+    std::uint64_t* palavras = linha(i);
+    for (int w = inicio >> 6; w <= fim >> 6; w++) {
+        /// máscara com os bits da palavra w que caem dentro do intervalo
+        const int a = std::max(inicio, w * 64) - w * 64;
+        const int b = std::min(fim, w * 64 + 63) - w * 64;
+        const std::uint64_t mascara = (~std::uint64_t{0} >> (63 - b)) & (~std::uint64_t{0} << a);
+        palavras[w] &= ~mascara;
+    }
+}
+
+std::uint64_t* bitmap::linha(int i) {
+    return palavras_ + passo_ * i;
+}
+
+const std::uint64_t* bitmap::linha(int i) const {
+    return palavras_ + passo_ * i;
+}
+
+///metodo que vai transformar uma area que é conexa inteira em uma matriz de zeros, ou seja em pretos
+void area_transformada(
+    bitmap& matrix,
+    int i,
+    int j,
+    structures::LinkedStack<std::tuple<int, int>>& stack) {
+
+    int largura = matrix.largura();
+    int altura = matrix.altura();
+    stack.push(std::make_tuple(i, j));
+
+    while (!stack.empty()) {
+        std::tuple<int, int> aux = stack.pop();
+        
+        i = std::get<0>(aux);
+        j = std::get<1>(aux);
+        matrix.apaga(i, j);
+        /// analisa os elementos da esquerda para ver se existe e sé branco
+        if (j > 0 && matrix.pixel(i, j - 1)) {
+            stack.push(std::make_tuple(i, j - 1));     
+        }
+        /// analisa os elementos da direita para ver se existe e sé branco
+        if (j < (largura - 1) && matrix.pixel(i, j + 1)) {
+            stack.push(std::make_tuple(i, j + 1));
+        }
+        /// analisa os elementos acima para ver se existe e sé branco
+        if (i > 0 && matrix.pixel(i - 1, j)) {
+            stack.push(std::make_tuple(i - 1, j));
+        }
+        /// analisa os elementos abaixo para ver se existe e sé branco
+        if (i < (altura - 1) && matrix.pixel(i + 1, j)) {
+            stack.push(std::make_tuple(i + 1, j));
+        }
+    }
+
+} 
+void uniao_busca::clear() {
+    pai_.clear();
+}
+
+int uniao_busca::novo() {
+    pai_.push_back(static_cast<int>(pai_.size()));
+    return static_cast<int>(pai_.size()) - 1;
+}
+
+int uniao_busca::busca(int x) {
+    /// compressão por divisão ao meio: cada nó visitado passa a apontar para o avô
+    while (pai_[x] != x) {
+        pai_[x] = pai_[pai_[x]];
+        x = pai_[x];
+    }
+    return x;
+}
+
+bool uniao_busca::une(int a, int b) {
+    a = busca(a);
+    b = busca(b);
+    if (a == b) {
+        return false;
+    }
+    /// a menor raiz fica como representante, mantendo os rótulos em ordem de leitura
+    if (a < b) {
+        pai_[b] = a;
+    } else {
+        pai_[a] = b;
+    }
+    return true;
+}
+
+std::size_t uniao_busca::size() const {
+    return pai_.size();
+}
+
+void uniao_busca::anexa(const uniao_busca& outro) {
+    const int deslocamento = static_cast<int>(pai_.size());
+    for (int pai : outro.pai_) {
+        pai_.push_back(pai + deslocamento);
+    }
+}
+
+double componente::centro_i() const {
+    return static_cast<double>(soma_linhas) / area;
+}
+
+double componente::centro_j() const {
+    return static_cast<double>(soma_colunas) / area;
+}
+
+void componente::junta(const componente& outro) {
+    area += outro.area;
+    topo = std::min(topo, outro.topo);
+    esquerda = std::min(esquerda, outro.esquerda);
+    base = std::max(base, outro.base);
+    direita = std::max(direita, outro.direita);
+    soma_linhas += outro.soma_linhas;
+    soma_colunas += outro.soma_colunas;
+}
+
+template<int Conectividade>
+int rotula_corridas(
+    const bitmap& matrix,
+    int primeira,
+    int ultima,
+    uniao_busca& conjuntos,
+    std::vector<corrida>& corridas,
+    std::vector<std::size_t>& linhas,
+    std::vector<componente>* estatisticas) {
+
+    static_assert(Conectividade == 4 || Conectividade == 8, "conectividade deve ser 4 ou 8");
+    /// com 8 vizinhos, corridas que só se tocam na diagonal também se unem
+    constexpr int diagonal = Conectividade == 8 ? 1 : 0;
+    int cont = 0;
+    const int largura = matrix.largura();
+    /// corridas da linha de cima ficam em [acima, atual)
+    std::size_t acima = corridas.size();
+    std::size_t atual = corridas.size();
+
+    for (int i = primeira; i < ultima; i++) {
+        linhas.push_back(corridas.size());
+        int j = 0;
+        while (j < largura) {
+            if (not matrix.pixel(i, j)) {
+                j++;
+                continue;
+            }
+            corrida nova{j, j, 0};
+            while (nova.fim + 1 < largura && matrix.pixel(i, nova.fim + 1)) {
+                nova.fim++;
+            }
+            nova.rotulo = conjuntos.novo();
+            cont++;
+            if (estatisticas != nullptr) {
+                const std::int64_t n = nova.fim - nova.inicio + 1;
+                estatisticas->push_back({n, i, nova.inicio, i, nova.fim, n * i,
+                                         n * (nova.inicio + nova.fim) / 2});
+            }
+            /// pula as corridas de cima que terminam antes desta começar
+            while (acima < atual && corridas[acima].fim + diagonal < nova.inicio) {
+                acima++;
+            }
+            /// une com todas as corridas de cima que se sobrepõem a esta
+            for (std::size_t k = acima;
+                 k < atual && corridas[k].inicio <= nova.fim + diagonal; k++) {
+                if (conjuntos.une(corridas[k].rotulo, nova.rotulo)) {
+                    cont--;
+                }
+            }
+            corridas.push_back(nova);
+            j = nova.fim + 1;
+        }
+        acima = atual;
+        atual = corridas.size();
+    }
+    linhas.push_back(corridas.size());
+    return cont;
+}
+
+template<int Conectividade>
+int area_estatisticas(
+    const bitmap& matrix,
+    rascunho& memoria,
+    std::vector<std::uint32_t>* mapa) {
+    uniao_busca& conjuntos = memoria.conjuntos;
+    std::vector<componente>& rotulos = memoria.estatisticas;
+    conjuntos.clear();
+    memoria.corridas.clear();
+    memoria.linhas.clear();
+    rotulos.clear();
+    rotula_corridas<Conectividade>(matrix, 0, matrix.altura(), conjuntos, memoria.corridas,
+                                   memoria.linhas, &rotulos);
+    /// cada rótulo soma suas estatísticas na raiz; como a raiz é sempre o menor rótulo
+    /// do conjunto, ela aparece antes de todos os outros e já tem seu lugar na saída
+    std::vector<componente>& componentes = memoria.componentes;
+    std::vector<int>& indice = memoria.indice;
+    componentes.clear();
+    indice.resize(rotulos.size());
+    for (int x = 0; x < static_cast<int>(rotulos.size()); x++) {
+        const int raiz = conjuntos.busca(x);
+        if (raiz == x) {
+            indice[x] = static_cast<int>(componentes.size());
+            componentes.push_back(rotulos[x]);
+        } else {
+            componentes[indice[raiz]].junta(rotulos[x]);
+        }
+    }
+    if (mapa != nullptr) {
+        pinta_rotulos(matrix, memoria.corridas, memoria.linhas, conjuntos, memoria.numeros,
+                      *mapa);
+    }
+    return static_cast<int>(componentes.size());
+}
+
+void pinta_rotulos(
+    const bitmap& matrix,
+    const std::vector<corrida>& corridas,
+    const std::vector<std::size_t>& linhas,
+    uniao_busca& conjuntos,
+    std::vector<std::uint32_t>& numeros,
+    std::vector<std::uint32_t>& rotulos) {
+
+    const std::size_t largura = matrix.largura();
+    rotulos.assign(largura * matrix.altura(), 0u);
+    /// a raiz é o menor rótulo do conjunto, então a primeira corrida de cada área é a
+    /// da raiz, e os números saem na ordem da leitura, como em area_estatisticas
+    numeros.assign(conjuntos.size(), 0u);
+    std::uint32_t proximo = 0u;
+    for (int i = 0; i < matrix.altura(); i++) {
+        std::uint32_t* linha = rotulos.data() + i * largura;
+        for (std::size_t k = linhas[i]; k < linhas[i + 1]; k++) {
+            const corrida& c = corridas[k];
+            std::uint32_t& numero = numeros[conjuntos.busca(c.rotulo)];
+            if (numero == 0u) {
+                numero = ++proximo;
+            }
+            std::fill(linha + c.inicio, linha + c.fim + 1, numero);
+        }
+    }
+}
+
+int faixas_uteis(const bitmap& matrix, int faixas) {
+    const int minimo_linhas = 64;
+    return std::max(1, std::min(faixas, matrix.altura() / minimo_linhas));
+}
+
+int rotula_faixas(const bitmap& matrix, int faixas, rascunho& memoria) {
+    paralelo::pool& ajudantes = paralelo::ajudantes_faixas(faixas);
+    faixas = faixas_uteis(matrix, faixas);
+    std::vector<faixa>& partes = memoria.faixas;
+    if (static_cast<int>(partes.size()) < faixas) {
+        partes.resize(faixas);
+    }
+
+    /// as faixas ainda não pegas, e os ajudantes que ainda não terminaram; quem pede
+    /// só volta quando todos terminam, porque eles usam este estado
+    struct trabalho {
+        trabalho(const bitmap& imagem, std::vector<faixa>& faixas, int total) :
+            matrix{imagem}, partes{faixas}, total{total} {}
+
+        const bitmap& matrix;
+        std::vector<faixa>& partes;
+        int total;
+        std::atomic<int> proxima{0};
+        int ativos{0};
+        std::mutex mutex;
+        std::condition_variable aviso;
+
+        void rotula() {
+            for (int f = proxima++; f < total; f = proxima++) {
+                faixa& parte = partes[f];
+                parte.conjuntos.clear();
+                parte.corridas.clear();
+                parte.linhas.clear();
+                parte.cont = rotula_corridas(matrix, parte.primeira, parte.ultima,
+                                             parte.conjuntos, parte.corridas, parte.linhas);
+            }
+        }
+    } estado{matrix, partes, faixas};
+    for (int f = 0; f < faixas; f++) {
+        const long long altura = matrix.altura();
+        partes[f].primeira = static_cast<int>(altura * f / faixas);
+        partes[f].ultima = static_cast<int>(altura * (f + 1) / faixas);
+    }
+    /// só pede ajuda a quem existe: num pool menor, quem pede pega as faixas que sobram
+    estado.ativos = std::min(faixas - 1, ajudantes.tamanho());
+    for (int h = 0; h < estado.ativos; h++) {
+        ajudantes.submete([e = &estado]() {
+            e->rotula();
+            /// avisa com o mutex travado: depois disso quem pede pode destruir o estado
+            std::lock_guard<std::mutex> trava(e->mutex);
+            e->ativos--;
+            e->aviso.notify_one();
+        });
+    }
+    estado.rotula();
+    {
+        std::unique_lock<std::mutex> trava(estado.mutex);
+        estado.aviso.wait(trava, [&estado]() { return estado.ativos == 0; });
+    }
+
+    /// junta os rótulos de todas as faixas num só conjunto, e une as corridas da
+    /// última linha de cada faixa com as que se sobrepõem na primeira linha da seguinte
+    uniao_busca& conjuntos = memoria.conjuntos;
+    conjuntos.clear();
+    int cont = 0;
+    int deslocamento_acima = 0;
+    for (int f = 0; f < faixas; f++) {
+        const int deslocamento = static_cast<int>(conjuntos.size());
+        conjuntos.anexa(partes[f].conjuntos);
+        cont += partes[f].cont;
+        if (f > 0) {
+            const faixa& cima = partes[f - 1];
+            const faixa& baixo = partes[f];
+            std::size_t k = cima.linhas[cima.linhas.size() - 2];
+            const std::size_t fim_cima = cima.linhas.back();
+            for (std::size_t b = baixo.linhas[0]; b < baixo.linhas[1]; b++) {
+                const corrida& nova = baixo.corridas[b];
+                while (k < fim_cima && cima.corridas[k].fim < nova.inicio) {
+                    k++;
+                }
+                for (std::size_t c = k; c < fim_cima && cima.corridas[c].inicio <= nova.fim; c++) {
+                    if (conjuntos.une(cima.corridas[c].rotulo + deslocamento_acima,
+                                      nova.rotulo + deslocamento)) {
+                        cont--;
+                    }
+                }
+            }
+        }
+        deslocamento_acima = deslocamento;
+    }
+    return cont;
+}
+
+void area_varredura(
+    bitmap& matrix,
+    int i,
+    int j,
+    std::vector<std::pair<int, int>>& pilha) {
+
+    const int largura = matrix.largura();
+    const int altura = matrix.altura();
+    pilha.clear();
+    pilha.emplace_back(i, j);
+
+    while (!pilha.empty()) {
+        std::tie(i, j) = pilha.back();
+        pilha.pop_back();
+        /// a semente pode já ter sido apagada por outra corrida
+        if (not matrix.pixel(i, j)) {
+            continue;
+        }
+        /// estende a corrida para os dois lados e apaga ela inteira
+        int inicio = j;
+        int fim = j;
+        while (inicio > 0 && matrix.pixel(i, inicio - 1)) {
+            inicio--;
+        }
+        while (fim < largura - 1 && matrix.pixel(i, fim + 1)) {
+            fim++;
+        }
+        matrix.apaga(i, inicio, fim);
+        /// nas linhas de cima e de baixo, empilha só o começo de cada corrida branca
+        for (int vizinha : {i - 1, i + 1}) {
+            if (vizinha < 0 || vizinha >= altura) {
+                continue;
+            }
+            bool anterior = false;
+            for (int x = inicio; x <= fim; x++) {
+                const bool atual = matrix.pixel(vizinha, x);
+                if (atual && !anterior) {
+                    pilha.emplace_back(vizinha, x);
+                }
+                anterior = atual;
+            }
+        }
+    }
+}
+
+/// método que vai contar as áreas conexas de 1's, e quando encontra ele incrementa um contador, 
+///e depois ele prenche com 0's esses elementos
+int area_contador(const bitmap& original, algoritmo modo, int faixas) {
+    return area_contador(original, modo, faixas, rascunho_local());
+}
+
+int area_contador(
+    const bitmap& original,
+    algoritmo modo,
+    int faixas,
+    rascunho& memoria,
+    std::vector<std::uint32_t>* mapa) {
+
+    /// uma imagem baixa demais para mais de uma faixa é rotulada aqui mesmo, em série
+    if (mapa == nullptr && modo == algoritmo::uniao_busca && faixas_uteis(original, faixas) > 1) {
+        return rotula_faixas(original, faixas, memoria);
+    }
+    if (mapa == nullptr && modo == algoritmo::bits) {
+        return area_bits(original, memoria);
+    }
+    if (mapa != nullptr || modo == algoritmo::uniao_busca) {
+        uniao_busca& conjuntos = memoria.conjuntos;
+        conjuntos.clear();
+        memoria.corridas.clear();
+        memoria.linhas.clear();
+        rotula_corridas(original, 0, original.altura(), conjuntos, memoria.corridas,
+                        memoria.linhas);
+        /// segunda passada: cada raiz que restou é uma área
+        int cont = 0;
+        for (int x = 0; x < static_cast<int>(conjuntos.size()); x++) {
+            if (conjuntos.busca(x) == x) {
+                cont++;
+            }
+        }
+        if (mapa != nullptr) {
+            pinta_rotulos(original, memoria.corridas, memoria.linhas, conjuntos, memoria.numeros,
+                          *mapa);
+        }
+        return cont;
+    }
+
+    bitmap& matrix = memoria.copia;
+    matrix.copia(original);
+    int cont = 0;    
+    for (int i = 0; i < matrix.altura(); i++) {
+        const std::uint64_t* linha = matrix.linha(i);
+        for (std::size_t w = 0u; w < matrix.passo(); w++) {
+            /// pula direto as palavras sem nenhum pixel branco
+            while (linha[w] != 0u) {
+                int j = static_cast<int>(w * 64u) + __builtin_ctzll(linha[w]);
+                cont++;
+                if (modo == algoritmo::varredura) {
+                    area_varredura(matrix, i, j, memoria.pilha);
+                } else {
+                    area_transformada(matrix, i, j, memoria.stack);
+                }
+            }
+        }
+    }
+    return cont;
+}
+
+escritor_bits::escritor_bits(bitmap& matrix) :
+    matrix_{matrix},
+    altura_{matrix.altura()},
+    linha_{matrix.altura() > 0 ? matrix.linha(0) : nullptr}
+{}
+
+escritor_bits::escritor_bits(
+    bitmap& linha,
+    int altura,
+    std::function<void(const std::uint64_t*)> ao_completar) :
+    matrix_{linha},
+    altura_{altura},
+    linha_{linha.linha(0)},
+    ao_completar_{std::move(ao_completar)}
+{}
+
+void escritor_bits::escreve(std::uint64_t bits, int n) {
+    while (n > 0 && not cheio()) {
+        /// grava no máximo o que ainda cabe na linha atual
+        const int k = std::min(n, matrix_.largura() - j_);
+        const std::uint64_t parte = k == 64 ? bits : bits & ((std::uint64_t{1} << k) - 1);
+        const int deslocamento = j_ & 63;
+        linha_[j_ >> 6] |= parte << deslocamento;
+        if (deslocamento + k > 64) {
+            linha_[(j_ >> 6) + 1] |= parte >> (64 - deslocamento);
+        }
+        bits = k == 64 ? 0u : bits >> k;
+        n -= k;
+        j_ += k;
+        if (j_ == matrix_.largura()) {
+            j_ = 0;
+            i_++;
+            if (ao_completar_) {
+                ao_completar_(linha_);
+                std::fill(linha_, linha_ + matrix_.passo(), std::uint64_t{0});
+            } else if (i_ < altura_) {
+                linha_ = matrix_.linha(i_);
+            }
+        }
+    }
+}
+
+void escritor_bits::completa() {
+    while (not cheio()) {
+        escreve(0u, 64);
+    }
+}
+
+bool escritor_bits::cheio() const {
+    return i_ >= altura_;
+}
+
+rotulador_fluxo::rotulador_fluxo(int largura) :
+    largura_{largura}
+{}
+
+void rotulador_fluxo::reinicia(int largura) {
+    largura_ = largura;
+    fechadas_ = 0;
+    abertas_ = 0;
+    anteriores_.clear();
+    atuais_.clear();
+}
+
+void rotulador_fluxo::linha(const std::uint64_t* palavras) {
+    /// os rótulos 0..abertas_-1 são as áreas da linha anterior,
+    /// e as corridas desta linha recebem os rótulos seguintes
+    atuais_.clear();
+    conjuntos_.clear();
+    for (int k = 0; k < abertas_; k++) {
+        conjuntos_.novo();
+    }
+    auto branco = [palavras](int j) { return (palavras[j >> 6] >> (j & 63)) & 1u; };
+    std::size_t acima = 0u;
+    int j = 0;
+    while (j < largura_) {
+        if (not branco(j)) {
+            j++;
+            continue;
+        }
+        corrida nova{j, j, conjuntos_.novo()};
+        while (nova.fim + 1 < largura_ && branco(nova.fim + 1)) {
+            nova.fim++;
+        }
+        while (acima < anteriores_.size() && anteriores_[acima].fim < nova.inicio) {
+            acima++;
+        }
+        for (std::size_t k = acima;
+             k < anteriores_.size() && anteriores_[k].inicio <= nova.fim; k++) {
+            conjuntos_.une(anteriores_[k].rotulo, nova.rotulo);
+        }
+        atuais_.push_back(nova);
+        j = nova.fim + 1;
+    }
+
+    /// renumera as áreas que continuam nesta linha como 0, 1, 2...
+    novos_.assign(conjuntos_.size(), -1);
+    int continuam = 0;
+    for (corrida& c : atuais_) {
+        int& novo = novos_[conjuntos_.busca(c.rotulo)];
+        if (novo < 0) {
+            novo = continuam++;
+        }
+        c.rotulo = novo;
+    }
+    /// uma área da linha anterior cuja raiz não chegou a esta linha terminou
+    for (int k = 0; k < abertas_; k++) {
+        if (novos_[conjuntos_.busca(k)] < 0) {
+            fechadas_++;
+        }
+    }
+    abertas_ = continuam;
+    anteriores_.swap(atuais_);
+}
+
+int rotulador_fluxo::termina() {
+    fechadas_ += abertas_;
+    abertas_ = 0;
+    anteriores_.clear();
+    return fechadas_;
+}
+
+/// monta palavras de 64 pixels byte a byte antes de gravá-las
+const char* decodifica_escalar(const char* p, const char* fim, escritor_bits& saida) {
+    std::uint64_t palavra = 0u;
+    int n = 0;
+    for (; p < fim && not saida.cheio(); p++) {
+        /// pula as quebras de linha durante a decodificação
+        if (*p == '\n') {
+            continue;
+        }
+        palavra |= std::uint64_t{*p == '1'} << n;
+        if (++n == 64) {
+            saida.escreve(palavra, n);
+            palavra = 0u;
+            n = 0;
+        }
+    }
+    saida.escreve(palavra, n);
+    return p;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/// compara 16 bytes com '1' e com '\n' e junta os resultados em máscaras de bits;
+/// um bloco sem quebra de linha vira 16 pixels de uma vez, e um bloco com quebra
+/// grava os pixels até ela e recomeça logo depois
+__attribute__((target("sse2")))
+const char* decodifica_sse2(const char* p, const char* fim, escritor_bits& saida) {
+    const __m128i um = _mm_set1_epi8('1');
+    const __m128i quebra = _mm_set1_epi8('\n');
+    while (fim - p >= 16 && not saida.cheio()) {
+        const __m128i bloco = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const unsigned uns = _mm_movemask_epi8(_mm_cmpeq_epi8(bloco, um));
+        const unsigned quebras = _mm_movemask_epi8(_mm_cmpeq_epi8(bloco, quebra));
+        if (quebras == 0u) {
+            saida.escreve(uns, 16);
+            p += 16;
+        } else {
+            const int n = __builtin_ctz(quebras);
+            saida.escreve(uns & ((1u << n) - 1u), n);
+            p += n + 1;
+        }
+    }
+    return decodifica_escalar(p, fim, saida);
+}
+
+/// igual à versão SSE2, com blocos de 32 bytes
+__attribute__((target("avx2")))
+const char* decodifica_avx2(const char* p, const char* fim, escritor_bits& saida) {
+    const __m256i um = _mm256_set1_epi8('1');
+    const __m256i quebra = _mm256_set1_epi8('\n');
+    while (fim - p >= 32 && not saida.cheio()) {
+        const __m256i bloco = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const std::uint32_t uns = _mm256_movemask_epi8(_mm256_cmpeq_epi8(bloco, um));
+        const std::uint32_t quebras = _mm256_movemask_epi8(_mm256_cmpeq_epi8(bloco, quebra));
+        if (quebras == 0u) {
+            saida.escreve(uns, 32);
+            p += 32;
+        } else {
+            const int n = __builtin_ctz(quebras);
+            saida.escreve(uns & ((std::uint64_t{1} << n) - 1u), n);
+            p += n + 1;
+        }
+    }
+    return decodifica_sse2(p, fim, saida);
+}
+#endif
+
+void decodifica(std::string_view str_matrix, escritor_bits& saida) {
+    using decodificador = const char* (*)(const char*, const char*, escritor_bits&);
+    static const decodificador melhor = []() -> decodificador {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return decodifica_avx2;
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return decodifica_sse2;
+        }
+#endif
+        return decodifica_escalar;
+    }();
+
+    melhor(str_matrix.data(), str_matrix.data() + str_matrix.length(), saida);
+}
+
+void decodifica(std::string_view str_matrix, bitmap& matrix) {
+    escritor_bits saida(matrix);
+    decodifica(str_matrix, saida);
+}
+
+int area_fluxo(std::string_view str_matrix, int width, int height, rascunho& memoria) {
+    bitmap& linha = memoria.linha;
+    linha.redimensiona(width, 1);
+    rotulador_fluxo& rotulador = memoria.fluxo;
+    rotulador.reinicia(width);
+    escritor_bits saida(linha, height, [&rotulador](const std::uint64_t* palavras) {
+        rotulador.linha(palavras);
+    });
+    decodifica(str_matrix, saida);
+    /// se o texto acabar antes, o resto da imagem é preto
+    saida.completa();
+    return rotulador.termina();
+}
+
+int imagem_rle::largura() const {
+    return largura_;
+}
+
+int imagem_rle::altura() const {
+    return static_cast<int>(linhas_.size()) - 1;
+}
+
+std::size_t imagem_rle::size() const {
+    return corridas_.size();
+}
+
+const corrida* imagem_rle::inicio(int i) const {
+    return corridas_.data() + linhas_[i];
+}
+
+const corrida* imagem_rle::fim(int i) const {
+    return corridas_.data() + linhas_[i + 1];
+}
+
+void imagem_rle::clear(int largura) {
+    largura_ = largura;
+    corridas_.clear();
+    linhas_.assign(1u, 0u);
+}
+
+void imagem_rle::nova_linha() {
+    linhas_.push_back(corridas_.size());
+}
+
+void imagem_rle::adiciona(int inicio, int fim) {
+    /// o rótulo de uma corrida é a sua posição na imagem
+    corridas_.push_back({inicio, fim, static_cast<int>(corridas_.size())});
+    linhas_.back() = corridas_.size();
+}
+
+void extrai_corridas(const std::uint64_t* palavras, int largura, imagem_rle& saida) {
+    const int total = static_cast<int>((static_cast<std::size_t>(largura) + 63u) / 64u);
+    int inicio = -1;
+    for (int w = 0; w < total; w++) {
+        std::uint64_t palavra = palavras[w];
+        int base = w * 64;
+        /// continua uma corrida que veio da palavra anterior
+        if (inicio >= 0) {
+            const int uns = palavra == ~std::uint64_t{0} ? 64 : __builtin_ctzll(~palavra);
+            if (uns == 64) {
+                continue;
+            }
+            saida.adiciona(inicio, base + uns - 1);
+            inicio = -1;
+            palavra &= ~std::uint64_t{0} << uns;
+        }
+        while (palavra != 0u) {
+            const int a = __builtin_ctzll(palavra);
+            /// pixels a partir de a: a corrida vai até o primeiro zero depois dele
+            const std::uint64_t resto = ~(palavra >> a);
+            if (resto == 0u) {
+                inicio = base + a;
+                break;
+            }
+            const int n = __builtin_ctzll(resto);
+            if (a + n == 64) {
+                inicio = base + a;
+                break;
+            }
+            saida.adiciona(base + a, base + a + n - 1);
+            palavra &= ~std::uint64_t{0} << (a + n);
+        }
+    }
+    if (inicio >= 0) {
+        saida.adiciona(inicio, largura - 1);
+    }
+}
+
+int area_rle(const imagem_rle& imagem, uniao_busca& conjuntos) {
+    /// cada corrida já é um rótulo; só falta unir as que se sobrepõem
+    conjuntos.clear();
+    for (std::size_t k = 0u; k < imagem.size(); k++) {
+        conjuntos.novo();
+    }
+    int cont = static_cast<int>(imagem.size());
+    for (int i = 1; i < imagem.altura(); i++) {
+        const corrida* acima = imagem.inicio(i - 1);
+        const corrida* fim_acima = imagem.fim(i - 1);
+        for (const corrida* c = imagem.inicio(i); c != imagem.fim(i); c++) {
+            while (acima != fim_acima && acima->fim < c->inicio) {
+                acima++;
+            }
+            for (const corrida* k = acima; k != fim_acima && k->inicio <= c->fim; k++) {
+                if (conjuntos.une(k->rotulo, c->rotulo)) {
+                    cont--;
+                }
+            }
+        }
+    }
+    return cont;
+}
+
+int area_bits(const bitmap& matrix, rascunho& memoria) {
+    const int largura = matrix.largura();
+    imagem_rle& corridas = memoria.rle;
+    corridas.clear(largura);
+    uniao_busca& conjuntos = memoria.conjuntos;
+    conjuntos.clear();
+    int cont = 0;
+    for (int i = 0; i < matrix.altura(); i++) {
+        const std::uint64_t* atual = matrix.linha(i);
+        corridas.nova_linha();
+        extrai_corridas(atual, largura, corridas);
+        for (const corrida* c = corridas.inicio(i); c != corridas.fim(i); c++) {
+            conjuntos.novo();
+            cont++;
+        }
+        if (i == 0) {
+            continue;
+        }
+
+        const std::uint64_t* acima = matrix.linha(i - 1);
+        const corrida* c = corridas.inicio(i);
+        const corrida* a = corridas.inicio(i - 1);
+        /// um trecho do E que chega ao fim da palavra continua na seguinte, e essa
+        /// continuação é das mesmas duas corridas, já unidas
+        bool continua = false;
+        for (std::size_t w = 0u; w < matrix.passo(); w++) {
+            std::uint64_t toque = atual[w] & acima[w];
+            if (continua) {
+                const int uns = toque == ~std::uint64_t{0} ? 64 : __builtin_ctzll(~toque);
+                if (uns == 64) {
+                    continue;
+                }
+                toque &= ~std::uint64_t{0} << uns;
+                continua = false;
+            }
+            const int base = static_cast<int>(w * 64u);
+            while (toque != 0u) {
+                const int inicio = __builtin_ctzll(toque);
+                const int j = base + inicio;
+                /// o trecho está dentro de uma única corrida de cada linha
+                while (c->fim < j) {
+                    c++;
+                }
+                while (a->fim < j) {
+                    a++;
+                }
+                if (conjuntos.une(a->rotulo, c->rotulo)) {
+                    cont--;
+                }
+                const std::uint64_t resto = ~(toque >> inicio);
+                const int n = resto == 0u ? 64 - inicio : __builtin_ctzll(resto);
+                if (inicio + n == 64) {
+                    continua = true;
+                    break;
+                }
+                toque &= ~std::uint64_t{0} << (inicio + n);
+            }
+        }
+    }
+    return cont;
+}
+
+/// metodo que vai criar uma nova matriz apartir dos 0's e 1's
+bitmap matriz_nova(std::string_view str_matrix, int width, int height) {
+    MEDE_FASE(medicao::matriz);
+    MEDE_BYTES(medicao::matriz, str_matrix.length());
+    MEDE_PIXELS(medicao::matriz, static_cast<std::int64_t>(width) * height);
+    bitmap matrix(width, height);
+    decodifica(str_matrix, matrix);
+    return matrix;
+}
+
+void matriz_nova(std::string_view str_matrix, int width, int height, bitmap& saida) {
+    MEDE_FASE(medicao::matriz);
+    MEDE_BYTES(medicao::matriz, str_matrix.length());
+    MEDE_PIXELS(medicao::matriz, static_cast<std::int64_t>(width) * height);
+    saida.redimensiona(width, height);
+    decodifica(str_matrix, saida);
+}
+
+void matriz_nova(std::string_view str_matrix, int width, int height, imagem_rle& saida,
+                 bitmap& linha) {
+    MEDE_FASE(medicao::matriz);
+    MEDE_BYTES(medicao::matriz, str_matrix.length());
+    MEDE_PIXELS(medicao::matriz, static_cast<std::int64_t>(width) * height);
+    saida.clear(width);
+    linha.redimensiona(width, 1);
+    escritor_bits escritor(linha, height, [width, &saida](const std::uint64_t* palavras) {
+        saida.nova_linha();
+        extrai_corridas(palavras, width, saida);
+    });
+    decodifica(str_matrix, escritor);
+    /// se o texto acabar antes, o resto da imagem é preto
+    escritor.completa();
+}
+
+rascunho& rascunho_local() {
+    thread_local rascunho memoria;
+    return memoria;
+}
+}   /// namespace area
+
 #endif
\ No newline at end of file
@@ -3,129 +3,144 @@
 #ifndef STRUCTURES_TRIE_H
 #define STRUCTURES_TRIE_H
 
+#include <cstdint>
 #include <string>
+#include <utility>
+#include <vector>
 
 #define ALPHABET_SIZE 26
 
-namespace structures { 
+namespace structures {
 
 class Trie {
  public:
   Trie(); //Novo Trie
-  void inserir(std::string word, int index, int length);
-  std::pair<int, int> procurar(std::string word);
-  int n_prefixo(std::string word);
-  int n_children();
-  int n_palavras();
+  void inserir(const std::string& word, int index, int length);
+  std::pair<int, int> procurar(const std::string& word) const;
+  int n_prefixo(const std::string& word) const;
+  int n_children() const;
+  int n_palavras() const;
 
  private:
-    Trie* children[ALPHABET_SIZE];
-    int index{0}, length{0};
+    //  Os nodos ficam todos num único vetor, na ordem em que foram criados, e os
+    //  filhos são índices de 32 bits nesse vetor; a raiz é o nodo 0, que nunca é
+    //  filho de ninguém, então 0 também marca a ausência de filho
+    struct Node {
+        std::uint32_t children[ALPHABET_SIZE]{};
+        int index{0}, length{0};
+    };
+
+    int n_palavras(std::uint32_t node) const;
+
+    std::vector<Node> nodes;
 };
 
 }  // namespace structures
 
 #endif
 
-//  No novo Trie o index que é a posição e o lenght que é o comprimento vão 
-//  ser definidos inicialmente como 0 e as posições de children que 
-//  são os nodos filhos são  nulos
+//  No novo Trie só existe a raiz, com o index que é a posição e o lenght que é o
+//  comprimento definidos inicialmente como 0 e sem nenhum filho
 
-structures::Trie::Trie() {
-	for (int i = 0; i < ALPHABET_SIZE; i++) {
-		children[i] = nullptr;
-	}
-}
-// Vai adicionar uma chave na árvore, word é a palavra a ser inserida, 
-// o index a posição no dicionario da palavra a ser inserida, e o lenght o 
+structures::Trie::Trie() : nodes(1) {}
+
+// Vai adicionar uma chave na árvore, word é a palavra a ser inserida,
+// o index a posição no dicionario da palavra a ser inserida, e o lenght o
 //comprimento da linha do dicionario que possui a palavra a ser inserida.
+// Os nodos novos vão para o fim do vetor, então as referências podem mudar
+// e o caminho é seguido pelos índices.
 
-void structures::Trie::inserir(std::string word, int index, int length) {
-	auto current = this;
-	for (int i = 0; i < word.length(); i++) {
+void structures::Trie::inserir(const std::string& word, int index, int length) {
+	std::uint32_t current = 0;
+	for (std::size_t i = 0; i < word.length(); i++) {
 		int position = word[i] - 'a';
-		if (!current->children[position]) {
-			current->children[position] = new Trie;
+		if (!nodes[current].children[position]) {
+			nodes[current].children[position] = static_cast<std::uint32_t>(nodes.size());
+			nodes.emplace_back();
     	}
-		current = current->children[position];
+		current = nodes[current].children[position];
 	}
-	current->index = index;
-	current->length = length;
+	nodes[current].index = index;
+	nodes[current].length = length;
 }
 
 // Vai procurar uma palavra na árvore, word é a palavra a ser procurada
-std::pair<int, int> structures::Trie::procurar(std::string word) {
+std::pair<int, int> structures::Trie::procurar(const std::string& word) const {
     //indica se a palavra pertence ao dicionario ou ou se é um prefixo
-	std::pair<int, int> pair; 
-// Caso a palavra pertença ao dicionário, o primeiro valor do par representa 
+	std::pair<int, int> pair;
+// Caso a palavra pertença ao dicionário, o primeiro valor do par representa
 // a posição da palavra enquanto o segundo  representa o comprimeto da linha.
-  
-	auto current = this;
-	for (int i = 0; i < word.length(); i++) {
+
+	std::uint32_t current = 0;
+	for (std::size_t i = 0; i < word.length(); i++) {
 		int position = word[i] - 'a';
-		if (!current->children[position]) {
+		if (!nodes[current].children[position]) {
 			pair.first = -1;
 			pair.second = -1;
 			return pair;
 		}
-		current = current->children[position];
+		current = nodes[current].children[position];
 	}
-	if (current && current->length == 0) {
+	if (nodes[current].length == 0) {
 		pair.first = 0;
 		pair.second = 0;
 		return pair;
 	}
-	pair.first = current->index;
-	pair.second = current->length;
+	pair.first = nodes[current].index;
+	pair.second = nodes[current].length;
 	return pair;
 }
-// Conta o número de vezes que a palavra é prefixo, 
-//o word é a palavra a ser contada, 
+// Conta o número de vezes que a palavra é prefixo,
+//o word é a palavra a ser contada,
 //ele ira retornar um número inteiro com as vezes que a palavra foi prefixo
 
-int structures::Trie::n_prefixo(std::string word) {
-	auto current = this;
+int structures::Trie::n_prefixo(const std::string& word) const {
+	std::uint32_t current = 0;
 	int n_prefix = 0;
-	for (int i = 0; i < word.length(); i++) {
+	for (std::size_t i = 0; i < word.length(); i++) {
 		int position = word[i] - 'a';
-		if (!current->children[position]) {
+		if (!nodes[current].children[position]) {
 			break;
 		}
-		current = current->children[position];
+		current = nodes[current].children[position];
 	}
-	if (current) {
-		if (current->length != 0) {
-			n_prefix++;
-		}
-		n_prefix += current->n_palavras();
+	if (nodes[current].length != 0) {
+		n_prefix++;
 	}
+	n_prefix += n_palavras(current);
 	return n_prefix;
 }
 
-//  Conta o número de filhos, e retorna um inteiro sendo ele o número de filhos
+//  Conta o número de filhos da raiz, e retorna um inteiro sendo ele o número de filhos
 
-int structures::Trie::n_children() {
-	auto current = this;
+int structures::Trie::n_children() const {
 	int n_children = 0;
 	for (int i = 0; i < ALPHABET_SIZE; i++) {
-		if (current->children[i]) {
+		if (nodes[0].children[i]) {
 			n_children++;
 		}
 	}
 	return n_children;
 }
-//  Conta o número de palavras a partir do nodo, e retorna um número inteiro 
+//  Conta o número de palavras a partir da raiz, e retorna um número inteiro
 //  com a quantidade de palavras.
 
-int structures::Trie::n_palavras() {
+int structures::Trie::n_palavras() const {
+	return n_palavras(0);
+}
+
+//  O mesmo, a partir do nodo de índice node
+
+int structures::Trie::n_palavras(std::uint32_t node) const {
 	int n_words = 0;
 	for (int i = 0; i < ALPHABET_SIZE; i++) {
-		if (children[i]) {
-			if (children[i]->length != 0) {
+		std::uint32_t child = nodes[node].children[i];
+		if (child) {
+			if (nodes[child].length != 0) {
 				n_words++;
 			}
-			n_words += children[i]->n_palavras();
+			n_words += n_palavras(child);
 		}
 	}
 	return n_words;
-}
\ No newline at end of file
+}